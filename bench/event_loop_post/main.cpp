@@ -0,0 +1,56 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "shcoro/stackless/event_loop.hpp"
+#include "shcoro/stackless/utility.hpp"
+
+using shcoro::Async;
+using shcoro::EventLoop;
+using shcoro::spawn_async_detached;
+
+constexpr size_t handoff_num = 1000000;
+
+// producer threads hand coroutines over to one loop with co_await loop.schedule_on()
+void bench_schedule_on(size_t producer_num) {
+    EventLoop loop;
+    std::atomic<size_t> done{0};
+    size_t total = handoff_num / producer_num * producer_num;
+
+    auto task = [&]() -> Async<void> {
+        co_await loop.schedule_on();
+        if (done.fetch_add(1, std::memory_order_relaxed) + 1 == total) {
+            loop.stop();
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> producers;
+    for (size_t i = 0; i < producer_num; i++) {
+        producers.emplace_back([&] {
+            for (size_t j = 0; j < total / producer_num; j++) {
+                spawn_async_detached(task());
+            }
+        });
+    }
+    loop.run_forever();
+    for (auto& t : producers) {
+        t.join();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    std::cout << "  " << producer_num << " producer(s): " << total / seconds / 1e6
+              << " M handoffs/s\n";
+}
+
+int main() {
+    std::cout << "cross-thread schedule_on into one EventLoop, " << handoff_num
+              << " handoffs\n";
+    for (size_t producer_num : {1, 2, 4}) {
+        bench_schedule_on(producer_num);
+    }
+}
@@ -0,0 +1,50 @@
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include "shcoro/stackless/fifo_scheduler.hpp"
+#include "shcoro/stackless/utility.hpp"
+
+using shcoro::Async;
+using shcoro::AsyncRO;
+using shcoro::FIFOAwaiter;
+using shcoro::FIFOScheduler;
+using shcoro::IntrusiveFIFOScheduler;
+using shcoro::spawn_async;
+
+Async<void> yield_loop(size_t yield_num) {
+    for (size_t i = 0; i < yield_num; i++) {
+        co_await FIFOAwaiter{};
+    }
+}
+
+// returns nanoseconds per yield
+template <typename SchedulerT>
+double bench(size_t coro_num, size_t yield_num) {
+    SchedulerT sched;
+    std::vector<AsyncRO<void>> tasks;
+    tasks.reserve(coro_num);
+    for (size_t i = 0; i < coro_num; i++) {
+        tasks.push_back(spawn_async(yield_loop(yield_num), sched));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    sched.run();
+    auto end = std::chrono::steady_clock::now();
+
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    return static_cast<double>(ns) / static_cast<double>(coro_num * yield_num);
+}
+
+int main() {
+    const size_t total_yields = 10000000;
+    for (size_t coro_num : {1, 100, 10000}) {
+        size_t yield_num = total_yields / coro_num;
+        std::cout << "coroutines: " << coro_num << ", yields each: " << yield_num << '\n';
+        std::cout << "  FIFOScheduler:          "
+                  << bench<FIFOScheduler>(coro_num, yield_num) << " ns/yield\n";
+        std::cout << "  IntrusiveFIFOScheduler: "
+                  << bench<IntrusiveFIFOScheduler>(coro_num, yield_num) << " ns/yield\n";
+    }
+    return 0;
+}
\ No newline at end of file
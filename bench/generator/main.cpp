@@ -0,0 +1,85 @@
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+
+#include "shcoro/stackless/generator.hpp"
+
+using shcoro::Generator;
+
+constexpr uint64_t value_num = 10000000;
+constexpr uint64_t record_num = 1000000;
+
+struct Record {
+    uint64_t id_;
+    std::array<char, 1024> payload_;
+};
+
+double elapsed_ns(std::chrono::steady_clock::time_point start) {
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+Generator<uint64_t> values() {
+    for (uint64_t i = 0; i < value_num; i++) {
+        co_yield i;
+    }
+}
+
+// the record is yielded in place, consumers read it through a reference
+template <typename T>
+Generator<T> records() {
+    Record record{};
+    for (uint64_t i = 0; i < record_num; i++) {
+        record.id_ = i;
+        co_yield record;
+    }
+}
+
+// every element is yielded one level deeper than the previous one
+Generator<uint64_t> chain(uint64_t depth) {
+    if (depth == 0) co_return;
+    co_yield depth;
+    co_yield shcoro::elements_of(chain(depth - 1));
+}
+
+void bench_nested(uint64_t depth) {
+    auto start = std::chrono::steady_clock::now();
+    uint64_t sum = 0;
+    for (auto value : chain(depth)) {
+        sum += value;
+    }
+    std::cout << "  depth " << depth << ": " << elapsed_ns(start) / depth
+              << " ns/element (checksum " << sum << ")\n";
+}
+
+template <typename T>
+void bench_records(const char* name) {
+    auto start = std::chrono::steady_clock::now();
+    uint64_t sum = 0;
+    for (auto&& record : records<T>()) {
+        sum += record.id_ + static_cast<uint64_t>(record.payload_[record.id_ % 1024]);
+    }
+    std::cout << "  " << name << ": " << elapsed_ns(start) / record_num
+              << " ns/element (checksum " << sum << ")\n";
+}
+
+int main() {
+    auto start = std::chrono::steady_clock::now();
+    uint64_t sum = 0;
+    for (auto value : values()) {
+        sum += value;
+    }
+    std::cout << value_num << " uint64_t values: " << elapsed_ns(start) / value_num
+              << " ns/element (checksum " << sum << ")\n";
+
+    std::cout << record_num << " records of " << sizeof(Record) << " bytes\n";
+    bench_records<Record>("Generator<Record>        ");
+    bench_records<const Record&>("Generator<const Record&>");
+    bench_records<Record&>("Generator<Record&>       ");
+
+    std::cout << "elements_of nested generators\n";
+    for (uint64_t depth : {100, 1000, 10000}) {
+        bench_nested(depth);
+    }
+}
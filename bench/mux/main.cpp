@@ -0,0 +1,95 @@
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include "shcoro/stackless/fifo_scheduler.hpp"
+#include "shcoro/stackless/utility.hpp"
+
+using shcoro::Async;
+using shcoro::FIFOAwaiter;
+using shcoro::IntrusiveFIFOScheduler;
+
+constexpr size_t round_num = 200000;
+
+// suspends once so that the adapter completes through the mux continuation
+Async<int> leaf(int value) {
+    co_await FIFOAwaiter{};
+    co_return value;
+}
+
+Async<long> fan_out_all(size_t rounds) {
+    long sum = 0;
+    for (size_t i = 0; i < rounds; i++) {
+        auto [a, b, c, d, e, f, g, h] = co_await shcoro::all_of(
+            leaf(1), leaf(2), leaf(3), leaf(4), leaf(5), leaf(6), leaf(7), leaf(8));
+        sum += a + b + c + d + e + f + g + h;
+    }
+    co_return sum;
+}
+
+Async<long> fan_out_any(size_t rounds) {
+    long sum = 0;
+    for (size_t i = 0; i < rounds; i++) {
+        auto ret = co_await shcoro::any_of(leaf(1), leaf(2), leaf(3), leaf(4), leaf(5),
+                                           leaf(6), leaf(7), leaf(8));
+        sum += static_cast<long>(ret.index());
+    }
+    co_return sum;
+}
+
+Async<long> fan_out_when_all(size_t rounds, int width) {
+    long sum = 0;
+    for (size_t i = 0; i < rounds; i++) {
+        std::vector<Async<int>> tasks;
+        tasks.reserve(width);
+        for (int j = 1; j <= width; j++) {
+            tasks.push_back(leaf(j));
+        }
+        for (int value : co_await shcoro::when_all(std::move(tasks))) {
+            sum += value;
+        }
+    }
+    co_return sum;
+}
+
+Async<long> fan_out_when_any(size_t rounds, int width) {
+    long sum = 0;
+    for (size_t i = 0; i < rounds; i++) {
+        std::vector<Async<int>> tasks;
+        tasks.reserve(width);
+        for (int j = 1; j <= width; j++) {
+            tasks.push_back(leaf(j));
+        }
+        auto [index, value] = co_await shcoro::when_any(std::move(tasks));
+        sum += static_cast<long>(index);
+    }
+    co_return sum;
+}
+
+template <typename Fn>
+void bench(const char* name, Fn fn, size_t rounds = round_num) {
+    IntrusiveFIFOScheduler sched;
+    auto start = std::chrono::steady_clock::now();
+    auto r = shcoro::spawn_async(fn(rounds), sched);
+    sched.run();
+    auto ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() -
+                                                       start)
+                  .count();
+    std::cout << "  " << name << ": " << ns / rounds << " ns/round (checksum " << r.get()
+              << ")\n";
+}
+
+int main() {
+    std::cout << round_num << " rounds of 8 tasks\n";
+    bench("all_of", fan_out_all);
+    bench("any_of", fan_out_any);
+    bench("when_all", [](size_t rounds) { return fan_out_when_all(rounds, 8); });
+    bench("when_any", [](size_t rounds) { return fan_out_when_any(rounds, 8); });
+
+    constexpr size_t shard_num = 256;
+    std::cout << round_num / 32 << " rounds of " << shard_num << " tasks\n";
+    bench(
+        "when_all", [](size_t rounds) { return fan_out_when_all(rounds, shard_num); },
+        round_num / 32);
+    return 0;
+}
@@ -0,0 +1,89 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "shcoro/stackless/fifo_scheduler.hpp"
+#include "shcoro/stackless/rw_lock.hpp"
+#include "shcoro/stackless/utility.hpp"
+
+using shcoro::Async;
+using shcoro::FIFOAwaiter;
+using shcoro::IntrusiveFIFOScheduler;
+using shcoro::RWLock;
+using shcoro::RWLockPolicy;
+
+constexpr size_t task_num = 64;
+constexpr size_t op_num = 20000;
+// scheduler rounds a lock is held for, so that waiters pile up
+constexpr size_t hold_rounds = 2;
+
+using clock_type = std::chrono::steady_clock;
+
+struct WaitStats {
+    double total_us = 0;
+    double max_us = 0;
+    size_t count = 0;
+
+    void add(clock_type::duration d) {
+        double us = std::chrono::duration<double, std::micro>(d).count();
+        total_us += us;
+        max_us = std::max(max_us, us);
+        count++;
+    }
+    double mean_us() const { return count ? total_us / count : 0; }
+};
+
+// every task issues op_num lock operations, write_percent of them write locks
+template <RWLockPolicy Policy>
+void bench_rw_lock(const char* name, uint32_t write_percent) {
+    IntrusiveFIFOScheduler sched;
+    RWLock<Policy> lock;
+    WaitStats reads, writes;
+
+    auto task = [&](uint32_t seed) -> Async<void> {
+        uint32_t state = seed * 2654435761u + 1;
+        for (size_t i = 0; i < op_num; i++) {
+            state = state * 1664525u + 1013904223u;
+            bool write = (state >> 16) % 100 < write_percent;
+            auto wait_start = clock_type::now();
+            if (write) {
+                auto guard = co_await lock.scoped_write_lock();
+                writes.add(clock_type::now() - wait_start);
+                for (size_t r = 0; r < hold_rounds; r++) co_await FIFOAwaiter{};
+            } else {
+                auto guard = co_await lock.scoped_read_lock();
+                reads.add(clock_type::now() - wait_start);
+                for (size_t r = 0; r < hold_rounds; r++) co_await FIFOAwaiter{};
+            }
+            co_await FIFOAwaiter{};
+        }
+    };
+
+    std::vector<shcoro::AsyncRO<void>> results;
+    results.reserve(task_num);
+    auto start = clock_type::now();
+    for (uint32_t i = 0; i < task_num; i++) {
+        results.push_back(shcoro::spawn_async(task(i), sched));
+    }
+    sched.run();
+    auto end = clock_type::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    std::cout << "  " << name << ": " << task_num * op_num / seconds / 1e6 << " M ops/s"
+              << ", read wait mean/max " << reads.mean_us() << "/" << reads.max_us
+              << " us, write wait mean/max " << writes.mean_us() << "/" << writes.max_us
+              << " us\n";
+}
+
+int main() {
+    std::cout << task_num << " coroutines x " << op_num << " lock operations, held for "
+              << hold_rounds << " scheduler rounds\n";
+    for (uint32_t write_percent : {1, 10, 50, 90}) {
+        std::cout << write_percent << "% writes\n";
+        bench_rw_lock<RWLockPolicy::READ_RPIOR>("READ_RPIOR ", write_percent);
+        bench_rw_lock<RWLockPolicy::WRITE_PRIOR>("WRITE_PRIOR", write_percent);
+        bench_rw_lock<RWLockPolicy::FAIR>("FAIR       ", write_percent);
+    }
+}
@@ -0,0 +1,101 @@
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "shcoro/stackless/timer.hpp"
+#include "shcoro/stackless/timing_wheel.hpp"
+#include "shcoro/stackless/utility.hpp"
+
+using shcoro::Async;
+using shcoro::AsyncRO;
+using shcoro::SchedulerNode;
+using shcoro::spawn_async;
+using shcoro::TimedAwaiter;
+using shcoro::TimedScheduler;
+using shcoro::TimingWheelScheduler;
+
+constexpr size_t timer_num = 1000000;
+
+double elapsed_ms(std::chrono::steady_clock::time_point start) {
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// handles are never resumed, only used as keys
+std::coroutine_handle<> fake_handle(size_t i) {
+    return std::coroutine_handle<>::from_address(reinterpret_cast<void*>((i + 1) * 64));
+}
+
+template <typename SchedulerT>
+void bench_register_cancel_handle(const char* name) {
+    SchedulerT sched;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < timer_num; i++) {
+        sched.register_coro(fake_handle(i), static_cast<time_t>(1 + i % 3600));
+    }
+    double insert_ms = elapsed_ms(start);
+
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < timer_num; i++) {
+        sched.unregister_coro(fake_handle(i));
+    }
+    double cancel_ms = elapsed_ms(start);
+
+    std::cout << "  " << name << " insert: " << insert_ms << " ms, cancel: " << cancel_ms
+              << " ms\n";
+}
+
+void bench_register_cancel_node() {
+    TimingWheelScheduler sched;
+    std::vector<SchedulerNode> nodes(timer_num);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < timer_num; i++) {
+        nodes[i].handle_ = fake_handle(i);
+        sched.register_node(nodes[i], static_cast<time_t>(1 + i % 3600));
+    }
+    double insert_ms = elapsed_ms(start);
+
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < timer_num; i++) {
+        sched.unregister_node(nodes[i]);
+    }
+    double cancel_ms = elapsed_ms(start);
+
+    std::cout << "  TimingWheelScheduler (node) insert: " << insert_ms
+              << " ms, cancel: " << cancel_ms << " ms\n";
+}
+
+Async<void> sleeper() { co_await TimedAwaiter{1}; }
+
+template <typename SchedulerT>
+void bench_expire(const char* name) {
+    SchedulerT sched;
+    std::vector<AsyncRO<void>> tasks;
+    tasks.reserve(timer_num);
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < timer_num; i++) {
+        tasks.push_back(spawn_async(sleeper(), sched));
+    }
+    double spawn_ms = elapsed_ms(start);
+
+    start = std::chrono::steady_clock::now();
+    sched.run();
+    double run_ms = elapsed_ms(start);
+
+    std::cout << "  " << name << " spawn: " << spawn_ms
+              << " ms, run (1s timers): " << run_ms << " ms\n";
+}
+
+int main() {
+    std::cout << timer_num << " timers, register + cancel\n";
+    bench_register_cancel_handle<TimedScheduler>("TimedScheduler");
+    bench_register_cancel_handle<TimingWheelScheduler>("TimingWheelScheduler (handle)");
+    bench_register_cancel_node();
+
+    std::cout << timer_num << " coroutines sleeping 1s, register + expire\n";
+    bench_expire<TimedScheduler>("TimedScheduler");
+    bench_expire<TimingWheelScheduler>("TimingWheelScheduler");
+    return 0;
+}
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include <iostream>
+#include <stdexcept>
 
 #include "shcoro/stackless/utility.hpp"
 
@@ -37,6 +38,10 @@ Async<long long> outter_func(int x) {
 
 int main() {
     auto ret = spawn_async(outter_func(3));
-    std::cout << "ret: " << ret.get() << '\n';
+    try {
+        std::cout << "ret: " << ret.get() << '\n';
+    } catch (const std::exception& e) {
+        std::cout << "caught: " << e.what() << '\n';
+    }
     return 0;
 }
\ No newline at end of file
@@ -20,13 +20,18 @@ class [[nodiscard]] Async : noncopyable {
                           promise_return_base<T>,
                           promise_exception_base,
                           promise_scheduler_base,
-                          promise_caller_base {
-        promise_type() { SHCORO_LOG("async promise created: ", this); }
+                          promise_cancellation_base,
+                          promise_caller_base,
+                          promise_allocator_base {
+        promise_type() {
+            SHCORO_LOG("async promise created: ", this);
+            scheduler_node_.handle_ =
+                std::coroutine_handle<promise_type>::from_promise(*this);
+        }
         ~promise_type() {
             SHCORO_LOG("async promise destroyed: ", this);
             if (scheduler_) {
-                scheduler_unregister_coro(
-                    scheduler_, std::coroutine_handle<promise_type>::from_promise(*this));
+                scheduler_unregister_node(scheduler_, scheduler_node_);
             }
         }
         auto get_return_object() { return Async{this}; }
@@ -40,13 +45,22 @@ class [[nodiscard]] Async : noncopyable {
         if constexpr (PromiseSchedulerConcept<CallerPromiseType>) {
             self_.promise().set_scheduler(caller.promise().get_scheduler());
         }
+        if constexpr (PromiseCancellationConcept<CallerPromiseType>) {
+            // a token set on the task itself takes precedence
+            if (!self_.promise().get_cancellation_token().can_be_cancelled()) {
+                self_.promise().set_cancellation_token(
+                    caller.promise().get_cancellation_token());
+            }
+        }
         return self_;
     }
 
+    // rethrows an exception that escaped the awaited coroutine
     auto await_resume()
         requires(!std::is_same_v<T, void>)
     {
         SHCORO_LOG("async await resume: ", &self_.promise());
+        self_.promise().rethrow_if_exception();
         return std::move(this->self_.promise().get_return_value());
     }
 
@@ -54,9 +68,13 @@ class [[nodiscard]] Async : noncopyable {
         requires(std::is_same_v<T, void>)
     {
         SHCORO_LOG("async await resume: ", &self_.promise());
+        self_.promise().rethrow_if_exception();
     }
 
     void set_scheduler(Scheduler sched) noexcept { self_.promise().set_scheduler(sched); }
+    void set_cancellation_token(CancellationToken token) noexcept {
+        self_.promise().set_cancellation_token(token);
+    }
 
     Async(Async&& other) noexcept : self_(std::exchange(other.self_, {})) {}
 
@@ -99,7 +117,9 @@ class [[nodiscard]] AsyncRO : noncopyable {
         }
     }
 
+    // rethrows an exception that escaped the spawned task
     T get() {
+        self_.promise().rethrow_if_exception();
         if constexpr (!std::is_same_v<T, void>) {
             return self_.promise().get_return_value();
         }
@@ -118,7 +138,7 @@ class AsyncDetacher : noncopyable {
    public:
     struct promise_type : promise_suspend_base<std::suspend_never, std::suspend_never>,
                           promise_return_base<void>,
-                          promise_exception_base
+                          promise_terminate_base
 
     {
         promise_type() { SHCORO_LOG("AsyncDetacher promise created: ", this); }
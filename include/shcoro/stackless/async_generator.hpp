@@ -0,0 +1,109 @@
+#pragma once
+
+#include <coroutine>
+#include <optional>
+#include <utility>
+
+#include "awaiter_base.hpp"
+#include "promise_base.hpp"
+#include "promise_concepts.hpp"
+#include "scheduler.hpp"
+#include "shcoro/utils/logger.h"
+#include "shcoro/utils/noncopyable.h"
+
+namespace shcoro {
+// Lazily produced sequence whose body may co_await, consumed with
+//     while (auto value = co_await gen.next()) { ... }
+// next() resumes the generator until its next co_yield or its end, which returns nullopt.
+// Like a nested Async, the generator runs on the scheduler of the coroutine awaiting
+// next(), so its body can wait on timers, IO or locks, and control goes back to the
+// consumer by symmetric transfer.
+template <typename T>
+class [[nodiscard]] AsyncGenerator : noncopyable {
+   public:
+    struct promise_type : promise_suspend_base<std::suspend_always, ResumeCallerAwaiter>,
+                          promise_exception_base,
+                          promise_scheduler_base,
+                          promise_cancellation_base,
+                          promise_caller_base,
+                          promise_allocator_base {
+        promise_type() {
+            SHCORO_LOG("async generator promise created: ", this);
+            scheduler_node_.handle_ =
+                std::coroutine_handle<promise_type>::from_promise(*this);
+        }
+        ~promise_type() {
+            SHCORO_LOG("async generator promise destroyed: ", this);
+            if (scheduler_) {
+                scheduler_unregister_node(scheduler_, scheduler_node_);
+            }
+        }
+        auto get_return_object() { return AsyncGenerator{this}; }
+
+        // hands the value to the consumer and resumes it
+        template <typename V>
+        ResumeCallerAwaiter yield_value(V&& value) {
+            value_.emplace(std::forward<V>(value));
+            return {};
+        }
+
+        void return_void() const noexcept {}
+
+        std::optional<T> take_value() { return std::exchange(value_, std::nullopt); }
+
+       private:
+        std::optional<T> value_;
+    };
+
+    struct NextAwaiter {
+        bool await_ready() const noexcept { return self_.done(); }
+
+        template <typename CallerPromiseType>
+        auto await_suspend(std::coroutine_handle<CallerPromiseType> caller) noexcept {
+            self_.promise().set_caller(caller);
+            if constexpr (PromiseSchedulerConcept<CallerPromiseType>) {
+                self_.promise().set_scheduler(caller.promise().get_scheduler());
+            }
+            if constexpr (PromiseCancellationConcept<CallerPromiseType>) {
+                self_.promise().set_cancellation_token(
+                    caller.promise().get_cancellation_token());
+            }
+            return self_;
+        }
+
+        // nullopt once the generator body has finished, rethrows an exception that
+        // escaped it
+        std::optional<T> await_resume() {
+            if (self_.done()) {
+                self_.promise().rethrow_if_exception();
+                return std::nullopt;
+            }
+            return self_.promise().take_value();
+        }
+
+        std::coroutine_handle<promise_type> self_;
+    };
+
+    AsyncGenerator(AsyncGenerator&& other) noexcept
+        : self_(std::exchange(other.self_, {})) {}
+
+    ~AsyncGenerator() {
+        if (self_) {
+            SHCORO_LOG("AsyncGenerator destroy: ", &self_.promise());
+            self_.destroy();
+        }
+    }
+
+    // must not be awaited again before the previous next() completed
+    [[nodiscard]] NextAwaiter next() noexcept { return NextAwaiter{self_}; }
+
+   private:
+    explicit AsyncGenerator(promise_type* promise) {
+        self_ = std::coroutine_handle<promise_type>::from_promise(*promise);
+        SHCORO_LOG("AsyncGenerator created: ", &self_.promise());
+    }
+
+    std::coroutine_handle<promise_type> self_{nullptr};
+};
+
+}  // namespace shcoro
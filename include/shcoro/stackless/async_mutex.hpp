@@ -0,0 +1,218 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+#include <thread>
+#include <utility>
+
+#include "shcoro/utils/logger.h"
+#include "shcoro/utils/noncopyable.h"
+#include "waiter.hpp"
+
+namespace shcoro {
+// Lock-free coroutine mutex that can be locked and unlocked from different threads
+// (cppcoro's async_mutex). One atomic word is either unlocked, locked without waiters
+// or the head of a LIFO stack of waiting tickets. unlock() moves that stack into a
+// FIFO list owned by the lock holder, so waiters are served in order of arrival.
+// A wait that can be cancelled queues a ticket of its own instead of the one embedded
+// in its awaiter: a cancelled waiter leaves it behind in the stack, unlock() frees it
+// once it gets there.
+class AsyncMutex final : noncopyable {
+   public:
+    struct LockAwaiter;
+
+    struct Ticket {
+        Ticket* next_{nullptr};
+        // nullptr once a cancelled waiter left, arming while it arms its cancellation
+        std::atomic<LockAwaiter*> awaiter_{nullptr};
+        bool owned_{false};  // allocated by a cancellable wait
+    };
+
+    struct LockAwaiter : Waiter {
+        explicit LockAwaiter(AsyncMutex* mutex) noexcept : mutex_(mutex) {
+            ticket_.awaiter_.store(this, std::memory_order_relaxed);
+        }
+
+        bool await_ready() const noexcept { return mutex_->try_lock(); }
+
+        template <typename CallerPromiseType>
+        bool await_suspend(std::coroutine_handle<CallerPromiseType> caller) noexcept {
+            set_waiter(caller);
+            if (!token_.can_be_cancelled()) {
+                // nothing may be touched once queued, the awaiter can be gone already
+                return mutex_->push(ticket_);
+            }
+            if (token_.cancellation_requested()) {
+                cancelled_ = true;
+                return yield_cancelled();
+            }
+            // a cancelled waiter leaves its ticket to unlock(), so it must outlive us
+            auto* ticket = new Ticket{nullptr, arming(), true};
+            if (!mutex_->push(*ticket)) {
+                // acquired meanwhile, continue without suspending
+                delete ticket;
+                return false;
+            }
+            // unlock() and the callback wait for the ticket to be armed, neither can take
+            // it meanwhile
+            owned_ticket_ = ticket;
+            if (!watch_cancellation(&on_cancel, this)) {
+                ticket->awaiter_.store(nullptr, std::memory_order_release);
+                return yield_cancelled();
+            }
+            ticket->awaiter_.store(this, std::memory_order_release);
+            return true;
+        }
+
+        // the lock was taken in await_ready / await_suspend or handed over by unlock,
+        // false if the wait was cancelled and the lock is not held
+        [[nodiscard]] bool await_resume() noexcept {
+            if (cancelled_) {
+                // unlock() frees the ticket left behind
+                return false;
+            }
+            delete owned_ticket_;
+            return true;
+        }
+
+        static void on_cancel(void* self) {
+            auto& awaiter = *static_cast<LockAwaiter*>(self);
+            if (take(*awaiter.owned_ticket_) == &awaiter) {
+                awaiter.cancel();
+            }
+        }
+
+        AsyncMutex* mutex_;
+        Ticket ticket_;
+        Ticket* owned_ticket_{nullptr};
+    };
+
+    explicit AsyncMutex(WakeupPolicy policy = WakeupPolicy::INLINE) noexcept
+        : policy_(policy) {}
+
+    bool try_lock() noexcept {
+        auto old = not_locked;
+        return state_.compare_exchange_strong(old, locked_no_waiters,
+                                              std::memory_order_acquire,
+                                              std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] LockAwaiter lock() noexcept { return LockAwaiter(this); }
+
+    // hands the lock to the oldest waiter that is still waiting, if any
+    void unlock() {
+        while (true) {
+            auto* head = waiters_;
+            if (head == nullptr) {
+                auto old = locked_no_waiters;
+                if (state_.compare_exchange_strong(old, not_locked,
+                                                   std::memory_order_release,
+                                                   std::memory_order_relaxed)) {
+                    return;
+                }
+                // new waiters arrived, take the whole stack and reverse it into FIFO order
+                old = state_.exchange(locked_no_waiters, std::memory_order_acquire);
+                auto* stack = reinterpret_cast<Ticket*>(old);
+                while (stack != nullptr) {
+                    auto* next = stack->next_;
+                    stack->next_ = head;
+                    head = stack;
+                    stack = next;
+                }
+            }
+            waiters_ = head->next_;
+            auto* awaiter = head->owned_ ? take(*head)
+                                         : head->awaiter_.load(std::memory_order_relaxed);
+            if (awaiter == nullptr) {
+                // left by a cancelled waiter
+                delete head;
+                continue;
+            }
+            SHCORO_LOG("async mutex hand over: ", awaiter);
+            awaiter->wake(policy_);
+            return;
+        }
+    }
+
+    // co_await mutex.scoped_lock() returns a guard that unlocks on destruction, an empty
+    // one if the wait was cancelled
+    using ScopedLock = ScopedLockGuard<AsyncMutex, &AsyncMutex::unlock>;
+
+    struct ScopedLockAwaiter : LockAwaiter {
+        using LockAwaiter::LockAwaiter;
+        ScopedLock await_resume() noexcept {
+            return LockAwaiter::await_resume() ? ScopedLock(*mutex_) : ScopedLock();
+        }
+    };
+
+    [[nodiscard]] ScopedLockAwaiter scoped_lock() noexcept {
+        return ScopedLockAwaiter(this);
+    }
+
+    // only tickets left behind by cancelled waiters may remain
+    ~AsyncMutex() {
+        auto old = state_.load(std::memory_order_acquire);
+        auto* stack = old == not_locked ? nullptr : reinterpret_cast<Ticket*>(old);
+        for (auto* list : {waiters_, stack}) {
+            while (list != nullptr) {
+                auto* next = list->next_;
+                if (list->owned_) {
+                    delete list;
+                }
+                list = next;
+            }
+        }
+    }
+
+   private:
+    // any other value points to the most recent Ticket
+    static constexpr uintptr_t not_locked = 1;
+    static constexpr uintptr_t locked_no_waiters = 0;
+
+    static LockAwaiter* arming() noexcept { return reinterpret_cast<LockAwaiter*>(1); }
+
+    // false if the mutex was acquired instead of queueing ticket
+    bool push(Ticket& ticket) noexcept {
+        SHCORO_LOG("async mutex queue ticket: ", &ticket);
+        auto old = state_.load(std::memory_order_acquire);
+        while (true) {
+            if (old == not_locked) {
+                if (state_.compare_exchange_weak(old, locked_no_waiters,
+                                                 std::memory_order_acquire,
+                                                 std::memory_order_relaxed)) {
+                    return false;
+                }
+            } else {
+                ticket.next_ = reinterpret_cast<Ticket*>(old);
+                if (state_.compare_exchange_weak(old, reinterpret_cast<uintptr_t>(&ticket),
+                                                 std::memory_order_release,
+                                                 std::memory_order_relaxed)) {
+                    return true;
+                }
+            }
+        }
+    }
+
+    // claims the waiter of an owned ticket, for either unlock() or the cancellation;
+    // whoever comes second gets nullptr
+    static LockAwaiter* take(Ticket& ticket) noexcept {
+        auto* awaiter = ticket.awaiter_.load(std::memory_order_acquire);
+        while (true) {
+            if (awaiter == arming()) {
+                // the waiter is arming its cancellation on another thread
+                std::this_thread::yield();
+                awaiter = ticket.awaiter_.load(std::memory_order_acquire);
+            } else if (ticket.awaiter_.compare_exchange_weak(awaiter, nullptr,
+                                                             std::memory_order_acq_rel,
+                                                             std::memory_order_acquire)) {
+                return awaiter;
+            }
+        }
+    }
+
+    std::atomic<uintptr_t> state_{not_locked};
+    Ticket* waiters_{nullptr};  // only touched by the lock holder
+    WakeupPolicy policy_;
+};
+}  // namespace shcoro
@@ -15,7 +15,7 @@ struct ResumeCallerAwaiter {
     std::coroutine_handle<> await_suspend(std::coroutine_handle<PromiseType> h)
         const noexcept {  // h is the current coroutine
         SHCORO_LOG("final suspense and resume caller: ", &h.promise());
-        return h.promise().get_caller();
+        return h.promise().continuation();
     }
 };
 
@@ -32,6 +32,23 @@ struct GetSchedulerAwaiter {
     Scheduler scheduler_;
 };
 
+// token of the running operation, cannot be cancelled without one. A coroutine handed
+// the token is not owned by the race of the running one, so it is never abandoned.
+struct GetCancellationTokenAwaiter {
+    constexpr bool await_ready() const noexcept { return false; }
+    auto await_resume() const noexcept { return token_; }
+
+    template <typename PromiseType>
+    bool await_suspend(std::coroutine_handle<PromiseType> h) noexcept {
+        if constexpr (PromiseCancellationConcept<PromiseType>) {
+            token_ = h.promise().get_cancellation_token().without_abandon();
+        }
+        return false;
+    }
+
+    CancellationToken token_;
+};
+
 struct GetCoroAwaiter {
     constexpr bool await_ready() const noexcept { return false; }
     auto await_resume() const noexcept { return coro_; }
@@ -0,0 +1,261 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include "shcoro/utils/noncopyable.h"
+
+namespace shcoro {
+
+class CancellationSource;
+class CancellationCallback;
+
+// Observes a CancellationSource, a default constructed token is never cancelled
+class CancellationToken {
+   public:
+    CancellationToken() noexcept = default;
+
+    bool can_be_cancelled() const noexcept { return source_ != nullptr; }
+    inline bool cancellation_requested() const noexcept;
+
+    // for a wait starting once cancellation was requested: true if the race owning the
+    // source takes the waiting coroutine as finished, it must then stay suspended for
+    // good and is destroyed by the race. Nothing is read after the race took it.
+    inline bool abandon() const noexcept;
+
+    // the same token for coroutines a race does not own, e.g. the children of an all_of,
+    // they are never abandoned
+    CancellationToken without_abandon() const noexcept {
+        auto token = *this;
+        token.abandonable_ = false;
+        return token;
+    }
+
+    friend bool operator==(CancellationToken lhs, CancellationToken rhs) noexcept {
+        return lhs.source_ == rhs.source_;
+    }
+
+   private:
+    friend class CancellationSource;
+    friend class CancellationCallback;
+
+    explicit CancellationToken(CancellationSource* source) noexcept : source_(source) {}
+
+    CancellationSource* source_{nullptr};
+    bool abandonable_{true};
+};
+
+// Function called once when cancellation is requested, registered on a token. The
+// callback is linked into its source, it is embedded in the awaiter (or promise) that
+// needs it so that registering never allocates, and must not move while armed.
+// arm() and reset() are called by the owner of the callback, possibly on another thread
+// than request_cancellation(): a reset() racing with the callback running elsewhere
+// waits for it to return, so the context may be destroyed right after.
+class CancellationCallback : noncopyable {
+   public:
+    using callback_type = void (*)(void*);
+
+    CancellationCallback() noexcept = default;
+    // only an unarmed callback may be moved, the new one is unarmed as well
+    CancellationCallback(CancellationCallback&&) noexcept {}
+    ~CancellationCallback() { reset(); }
+
+    // fn(context) runs on request_cancellation(), a no-op for a token that can not be
+    // cancelled. false if cancellation was requested already, fn is not armed then; the
+    // check is made under the source's lock, so no request is lost in between.
+    inline bool arm(CancellationToken token, callback_type fn, void* context) noexcept;
+    inline void reset() noexcept;
+
+    bool armed() const noexcept {
+        return source_.load(std::memory_order_acquire) != nullptr;
+    }
+
+   private:
+    friend class CancellationSource;
+
+    // set by arm(), cleared by reset() or once the callback ran
+    std::atomic<CancellationSource*> source_{nullptr};
+    CancellationCallback* prev_{nullptr};
+    CancellationCallback* next_{nullptr};
+    callback_type fn_{nullptr};
+    void* context_{nullptr};
+    bool linked_{false};
+};
+
+// Requests cancellation of the operations watching its tokens. Callbacks may be armed,
+// reset and requested from different threads, e.g. by tasks of one any_of running on a
+// WorkStealingScheduler. The callbacks run on the requesting thread, which resumes the
+// cancelled coroutines from within request_cancellation().
+class CancellationSource : noncopyable {
+   public:
+    CancellationSource() noexcept = default;
+    ~CancellationSource() {
+        std::unique_lock lock(mutex_);
+        if (requester_ == std::this_thread::get_id()) {
+            // destroyed by one of its own callbacks
+            *destroyed_ = true;
+            if (!reset_) {
+                running_->source_.store(nullptr, std::memory_order_relaxed);
+            }
+        } else {
+            while (requester_ != std::thread::id{}) {
+                lock.unlock();
+                std::this_thread::yield();
+                lock.lock();
+            }
+        }
+        while (head_) {
+            head_->source_.store(nullptr, std::memory_order_relaxed);
+            unlink(*head_);
+        }
+    }
+
+    CancellationToken token() noexcept { return CancellationToken{this}; }
+    bool cancellation_requested() const noexcept {
+        return requested_.load(std::memory_order_acquire);
+    }
+
+    using abandon_type = bool (*)(void*);
+
+    // installed by a race on its own source before handing out tokens, answers
+    // CancellationToken::abandon()
+    void set_abandon_handler(abandon_type fn, void* context) noexcept {
+        abandon_ = fn;
+        abandon_context_ = context;
+    }
+
+    // every callback is unregistered right before it runs, so a callback may destroy
+    // other ones or even the source (e.g. by resuming a coroutine that finishes). Only
+    // the first call runs the callbacks, later ones (from within a callback or from
+    // another thread) return right away.
+    void request_cancellation() {
+        std::unique_lock lock(mutex_);
+        if (requested_.load(std::memory_order_relaxed)) {
+            return;
+        }
+        requested_.store(true, std::memory_order_release);
+        requester_ = std::this_thread::get_id();
+        bool destroyed = false;
+        destroyed_ = &destroyed;
+        while (head_) {
+            auto& callback = *head_;
+            unlink(callback);
+            running_ = &callback;
+            reset_ = false;
+            lock.unlock();
+            callback.fn_(callback.context_);
+            if (destroyed) {
+                return;
+            }
+            lock.lock();
+            if (!reset_) {
+                callback.source_.store(nullptr, std::memory_order_release);
+            }
+            running_ = nullptr;
+        }
+        requester_ = std::thread::id{};
+        destroyed_ = nullptr;
+    }
+
+   private:
+    friend class CancellationToken;
+    friend class CancellationCallback;
+
+    void link(CancellationCallback& callback) noexcept {
+        callback.linked_ = true;
+        callback.prev_ = nullptr;
+        callback.next_ = head_;
+        if (head_) {
+            head_->prev_ = &callback;
+        }
+        head_ = &callback;
+    }
+
+    void unlink(CancellationCallback& callback) noexcept {
+        if (callback.prev_) {
+            callback.prev_->next_ = callback.next_;
+        } else {
+            head_ = callback.next_;
+        }
+        if (callback.next_) {
+            callback.next_->prev_ = callback.prev_;
+        }
+        callback.linked_ = false;
+        callback.prev_ = callback.next_ = nullptr;
+    }
+
+    // takes callback out, or waits until it returned if it is running on another thread
+    void remove(CancellationCallback& callback) noexcept {
+        std::unique_lock lock(mutex_);
+        if (callback.linked_) {
+            unlink(callback);
+            return;
+        }
+        if (running_ != &callback) {
+            return;
+        }
+        if (requester_ == std::this_thread::get_id()) {
+            // reset from within the callback, it may be gone once it returns
+            reset_ = true;
+            return;
+        }
+        while (running_ == &callback) {
+            lock.unlock();
+            std::this_thread::yield();
+            lock.lock();
+        }
+    }
+
+    std::mutex mutex_;
+    CancellationCallback* head_{nullptr};
+    std::atomic<bool> requested_{false};
+    // while request_cancellation() runs the callbacks
+    std::thread::id requester_;
+    CancellationCallback* running_{nullptr};
+    bool reset_{false};
+    bool* destroyed_{nullptr};
+    abandon_type abandon_{nullptr};
+    void* abandon_context_{nullptr};
+};
+
+bool CancellationToken::cancellation_requested() const noexcept {
+    return source_ && source_->cancellation_requested();
+}
+
+bool CancellationToken::abandon() const noexcept {
+    auto* source = source_;
+    if (!source || !abandonable_ || !source->abandon_) {
+        return false;
+    }
+    return source->abandon_(source->abandon_context_);
+}
+
+bool CancellationCallback::arm(CancellationToken token, callback_type fn,
+                               void* context) noexcept {
+    reset();
+    auto* source = token.source_;
+    if (!source) {
+        return true;
+    }
+    std::lock_guard guard(source->mutex_);
+    if (source->requested_.load(std::memory_order_relaxed)) {
+        return false;
+    }
+    fn_ = fn;
+    context_ = context;
+    source_.store(source, std::memory_order_relaxed);
+    source->link(*this);
+    return true;
+}
+
+void CancellationCallback::reset() noexcept {
+    if (auto* source = source_.load(std::memory_order_acquire)) {
+        source->remove(*this);
+        source_.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+}  // namespace shcoro
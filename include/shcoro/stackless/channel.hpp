@@ -0,0 +1,228 @@
+#pragma once
+
+#include <coroutine>
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+#include "shcoro/utils/noncopyable.h"
+#include "shcoro/utils/null_lock.h"
+#include "shcoro/utils/ring_buffer.h"
+#include "waiter.hpp"
+
+namespace shcoro {
+// Bounded multi-producer multi-consumer channel between coroutines.
+// Values are buffered in a ring buffer whose capacity is a template argument, or given to
+// the constructor with Capacity = dynamic_capacity; a capacity of 0 makes every send wait
+// for a receiver. Senders suspend while the buffer is full.
+// A value sent while a receiver is parked is moved straight into its awaiter and a parked
+// sender's value is moved into the slot a receive frees up, so nothing is allocated per
+// message and a handed over value never goes through the buffer.
+// After close(), send() returns false and recv() drains the buffer, then returns nullopt.
+// A parked send or receive is withdrawn when cancellation of its coroutine is requested,
+// it then returns false / nullopt as well.
+// LockT as for AsyncSemaphore: NullLock for one thread, std::mutex across threads.
+template <typename T, size_t Capacity = dynamic_capacity, typename LockT = NullLock>
+class Channel final : noncopyable {
+   public:
+    struct SendAwaiter : Waiter {
+        SendAwaiter(Channel* channel, T value)
+            : channel_(channel), value_(std::move(value)) {}
+
+        bool await_ready() { return channel_->send_or_park(*this, false); }
+
+        template <typename CallerPromiseType>
+        bool await_suspend(std::coroutine_handle<CallerPromiseType> caller) {
+            set_waiter(caller);
+            if (!channel_->send_or_park(*this, true)) {
+                return true;
+            }
+            // completed, closed or cancelled before parking, only the last one yields
+            return cancelled_ && yield_cancelled();
+        }
+
+        // false if the channel was closed or the wait cancelled, the value is then dropped
+        [[nodiscard]] bool await_resume() noexcept { return sent_; }
+
+        static void on_cancel(void* self) {
+            auto& sender = *static_cast<SendAwaiter*>(self);
+            bool removed = false;
+            {
+                std::lock_guard guard(sender.channel_->mutex_);
+                removed = sender.channel_->senders_.remove(sender);
+            }
+            if (removed) {
+                sender.cancel();
+            }
+        }
+
+        Channel* channel_{nullptr};
+        T value_;
+        bool sent_{false};
+        SendAwaiter* next_{nullptr};
+    };
+
+    struct RecvAwaiter : Waiter {
+        RecvAwaiter(Channel* channel) : channel_(channel) {}
+
+        bool await_ready() { return channel_->recv_or_park(*this, false); }
+
+        template <typename CallerPromiseType>
+        bool await_suspend(std::coroutine_handle<CallerPromiseType> caller) {
+            set_waiter(caller);
+            if (!channel_->recv_or_park(*this, true)) {
+                return true;
+            }
+            // completed, closed or cancelled before parking, only the last one yields
+            return cancelled_ && yield_cancelled();
+        }
+
+        // nullopt once the channel is closed and drained, or if the wait was cancelled
+        std::optional<T> await_resume() { return std::move(value_); }
+
+        static void on_cancel(void* self) {
+            auto& receiver = *static_cast<RecvAwaiter*>(self);
+            bool removed = false;
+            {
+                std::lock_guard guard(receiver.channel_->mutex_);
+                removed = receiver.channel_->receivers_.remove(receiver);
+            }
+            if (removed) {
+                receiver.cancel();
+            }
+        }
+
+        Channel* channel_{nullptr};
+        std::optional<T> value_;
+        RecvAwaiter* next_{nullptr};
+    };
+
+    explicit Channel(WakeupPolicy policy = WakeupPolicy::INLINE)
+        requires(Capacity != dynamic_capacity)
+        : policy_(policy) {}
+
+    explicit Channel(size_t capacity, WakeupPolicy policy = WakeupPolicy::INLINE)
+        requires(Capacity == dynamic_capacity)
+        : buffer_(capacity), policy_(policy) {}
+
+    ~Channel() = default;
+
+    [[nodiscard]] SendAwaiter send(T value) { return SendAwaiter(this, std::move(value)); }
+    [[nodiscard]] RecvAwaiter recv() { return RecvAwaiter(this); }
+
+    // nullopt if nothing can be received without waiting
+    std::optional<T> try_recv() {
+        RecvAwaiter awaiter(this);
+        recv_or_park(awaiter, false);
+        return std::move(awaiter.value_);
+    }
+
+    // wakes every parked sender and receiver, buffered values can still be received
+    void close() {
+        WaiterQueue<SendAwaiter> senders;
+        WaiterQueue<RecvAwaiter> receivers;
+        {
+            std::lock_guard guard(mutex_);
+            closed_ = true;
+            senders = std::exchange(senders_, {});
+            receivers = std::exchange(receivers_, {});
+        }
+        while (!senders.empty()) {
+            senders.pop().wake(policy_);
+        }
+        while (!receivers.empty()) {
+            receivers.pop().wake(policy_);
+        }
+    }
+
+    bool closed() {
+        std::lock_guard guard(mutex_);
+        return closed_;
+    }
+
+    size_t size() {
+        std::lock_guard guard(mutex_);
+        return buffer_.size();
+    }
+
+    size_t capacity() const noexcept { return buffer_.capacity(); }
+
+   private:
+    // true if the send completed, parks the sender otherwise if park is set; a sender whose
+    // cancellation was requested already completes without sending instead of parking
+    bool send_or_park(SendAwaiter& sender, bool park) {
+        RecvAwaiter* receiver = nullptr;
+        {
+            std::lock_guard guard(mutex_);
+            if (closed_) {
+                return true;
+            }
+            if (!receivers_.empty()) {
+                // the buffer is empty when a receiver is parked
+                receiver = &receivers_.pop();
+                receiver->value_.emplace(std::move(sender.value_));
+            } else if (!buffer_.full()) {
+                buffer_.push(std::move(sender.value_));
+            } else {
+                if (!park) {
+                    return false;
+                }
+                if (!sender.watch_cancellation(&SendAwaiter::on_cancel, &sender)) {
+                    return true;
+                }
+                senders_.push(sender);
+                return false;
+            }
+            sender.sent_ = true;
+        }
+        if (receiver) {
+            receiver->wake(policy_);
+        }
+        return true;
+    }
+
+    // true if the receive completed, parks the receiver otherwise if park is set, as for
+    // send_or_park
+    bool recv_or_park(RecvAwaiter& receiver, bool park) {
+        SendAwaiter* sender = nullptr;
+        {
+            std::lock_guard guard(mutex_);
+            if (!buffer_.empty()) {
+                receiver.value_.emplace(buffer_.pop());
+                if (!senders_.empty()) {
+                    sender = &senders_.pop();
+                    buffer_.push(std::move(sender->value_));
+                }
+            } else if (!senders_.empty()) {
+                // unbuffered channel
+                sender = &senders_.pop();
+                receiver.value_.emplace(std::move(sender->value_));
+            } else if (!closed_) {
+                if (!park) {
+                    return false;
+                }
+                if (!receiver.watch_cancellation(&RecvAwaiter::on_cancel, &receiver)) {
+                    return true;
+                }
+                receivers_.push(receiver);
+                return false;
+            }
+            if (sender) {
+                sender->sent_ = true;
+            }
+        }
+        if (sender) {
+            sender->wake(policy_);
+        }
+        return true;
+    }
+
+    LockT mutex_;
+    RingBuffer<T, Capacity> buffer_;
+    WaiterQueue<SendAwaiter> senders_;
+    WaiterQueue<RecvAwaiter> receivers_;
+    bool closed_{false};
+    WakeupPolicy policy_;
+};
+}  // namespace shcoro
@@ -0,0 +1,314 @@
+#pragma once
+
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "async.hpp"
+#include "io_awaiter.hpp"
+#include "shcoro/utils/exception.h"
+#include "shcoro/utils/logger.h"
+#include "shcoro/utils/noncopyable.h"
+
+namespace shcoro {
+
+enum class IOInterest : uint32_t {
+    READ = EPOLLIN,
+    WRITE = EPOLLOUT,
+};
+
+// Value of EpollScheduler: wait until fd is ready for interest
+struct IOEvent {
+    int fd_;
+    IOInterest interest_;
+    bool edge_triggered_{false};
+};
+
+// Reactor over epoll. Several coroutines may wait on one fd, in FIFO order per direction:
+// a level-triggered readiness resumes the first of them, an edge resumes them all to retry
+// their syscall. A fd joins the epoll set on its first wait and stays there until forget(), level-triggered fds are
+// armed one-shot so a wait costs one epoll_ctl and an idle fd never wakes the poller,
+// edge-triggered ones are added once for both directions. Waiting coroutines are resumed
+// by run() or run_once(), fds are expected to be non-blocking.
+class EpollScheduler : noncopyable {
+   public:
+    using value_type = IOEvent;
+
+    EpollScheduler() : epfd_(::epoll_create1(EPOLL_CLOEXEC)) {
+        if (epfd_ < 0) {
+            detail::throw_exception(
+                std::system_error(errno, std::system_category(), "epoll_create1"));
+        }
+    }
+
+    ~EpollScheduler() { ::close(epfd_); }
+
+    void register_coro(std::coroutine_handle<> coro, const IOEvent& event) {
+        SHCORO_LOG("epoll register: fd ", event.fd_);
+        auto& state = fds_[event.fd_];
+        auto& queue = event.interest_ == IOInterest::READ ? state.readers_ : state.writers_;
+        queue.push_back(coro);
+        state.edge_triggered_ = event.edge_triggered_;
+        waiters_[coro.address()] = event.fd_;
+        pending_++;
+        if (!update_interest(event.fd_, state)) {
+            // e.g. a regular file, let the caller retry its syscall to get the error
+            queue.pop_back();
+            make_ready(coro);
+            if (!state.added_ && state.readers_.empty() && state.writers_.empty()) {
+                fds_.erase(event.fd_);
+            }
+        }
+    }
+
+    // removes fd from the epoll set, to be called before fd is closed since a closed fd
+    // leaves the set behind our back. Its waiters are resumed to retry their syscall.
+    void forget(int fd) {
+        auto it = fds_.find(fd);
+        if (it == fds_.end()) {
+            return;
+        }
+        SHCORO_LOG("epoll forget: fd ", fd);
+        auto& state = it->second;
+        if (state.added_) {
+            (void)::epoll_ctl(epfd_, EPOLL_CTL_DEL, fd, nullptr);
+        }
+        wake(state.readers_, true);
+        wake(state.writers_, true);
+        fds_.erase(it);
+    }
+
+    // fd stays in the epoll set and only interrupts poll(), it is drained with a read of
+    // 8 bytes (eventfd) and resumes nothing
+    void set_wakeup_fd(int fd) {
+        epoll_event ev{.events = EPOLLIN, .data = {.fd = fd}};
+        if (::epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            detail::throw_exception(
+                std::system_error(errno, std::system_category(), "epoll_ctl"));
+        }
+        wakeup_fd_ = fd;
+    }
+
+    // true if coro was waiting or ready, it will not be resumed then
+    bool unregister_coro(std::coroutine_handle<> coro) {
+        if (pending_ == 0) [[likely]] {
+            return false;
+        }
+        auto it = waiters_.find(coro.address());
+        if (it == waiters_.end()) {
+            // ready but not resumed yet
+            auto r = std::find(ready_.begin(), ready_.end(), coro);
+            if (r == ready_.end()) {
+                return false;
+            }
+            ready_.erase(r);
+            pending_--;
+            return true;
+        }
+        SHCORO_LOG("epoll unregister: fd ", it->second);
+        auto& state = fds_[it->second];
+        waiters_.erase(it);
+        // the fd stays armed, it fires at most once more and resumes nothing
+        std::erase(state.readers_, coro);
+        std::erase(state.writers_, coro);
+        pending_--;
+        return true;
+    }
+
+    // resumes the coroutines whose fd is ready, never blocks
+    void run_once() { poll(0); }
+
+    // blocks in epoll_wait until no coroutine waits anymore
+    void run() {
+        while (pending_ != 0) {
+            poll(-1);
+        }
+    }
+
+    // waits up to timeout_ms (-1 forever) for a fd, then resumes the ready coroutines
+    void poll(int timeout_ms) {
+        // skip the wait if some coroutine is already runnable
+        int n = ::epoll_wait(epfd_, events_, max_events, ready_.empty() ? timeout_ms : 0);
+        for (int i = 0; i < n; i++) {
+            int fd = events_[i].data.fd;
+            uint32_t revents = events_[i].events;
+            if (fd == wakeup_fd_) {
+                uint64_t count;
+                (void)::read(fd, &count, sizeof(count));
+                continue;
+            }
+            auto it = fds_.find(fd);
+            if (it == fds_.end()) {
+                // forgotten by a coroutine resumed earlier in this loop
+                continue;
+            }
+            auto& state = it->second;
+            if (!state.edge_triggered_) {
+                // disarmed by EPOLLONESHOT
+                state.events_ = 0;
+            }
+            if (revents & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                wake(state.readers_, state.edge_triggered_);
+            }
+            if (revents & (EPOLLOUT | EPOLLHUP | EPOLLERR)) {
+                wake(state.writers_, state.edge_triggered_);
+            }
+            update_interest(fd, state);
+        }
+
+        // a resumed coroutine may destroy one that is still queued, see unregister_coro
+        while (!ready_.empty()) {
+            auto handle = ready_.front();
+            ready_.pop_front();
+            pending_--;
+            SHCORO_LOG("epoll resume handle");
+            handle.resume();
+        }
+    }
+
+    size_t pending_number() const { return pending_; }
+
+   private:
+    struct FdState {
+        std::vector<std::coroutine_handle<>> readers_;
+        std::vector<std::coroutine_handle<>> writers_;
+        uint32_t events_{0};  // events currently armed, 0 if none
+        bool added_{false};   // fd is in the epoll set
+        bool edge_triggered_{false};
+    };
+
+    // arms fd for its waiters, false if epoll refuses fd
+    bool update_interest(int fd, FdState& state) {
+        uint32_t events;
+        if (state.edge_triggered_) {
+            // edges of a direction nobody waits for are dropped, the IO helpers try
+            // their syscall before waiting
+            events = EPOLLIN | EPOLLRDHUP | EPOLLOUT | EPOLLET;
+        } else {
+            events =
+                (!state.readers_.empty() ? static_cast<uint32_t>(EPOLLIN | EPOLLRDHUP)
+                                         : uint32_t{0}) |
+                (!state.writers_.empty() ? static_cast<uint32_t>(EPOLLOUT) : uint32_t{0});
+            if (events == 0) {
+                return true;
+            }
+            events |= EPOLLONESHOT;
+        }
+        if (state.added_ && (events & ~state.events_) == 0 &&
+            (events & EPOLLET) == (state.events_ & EPOLLET)) {
+            return true;
+        }
+
+        epoll_event ev{.events = events, .data = {.fd = fd}};
+        int op = state.added_ ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+        if (::epoll_ctl(epfd_, op, fd, &ev) < 0) {
+            // the fd number was closed and reused without forget(), or added by a
+            // previous owner of the number
+            if (errno != (op == EPOLL_CTL_MOD ? ENOENT : EEXIST)) {
+                return false;
+            }
+            op = op == EPOLL_CTL_MOD ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+            if (::epoll_ctl(epfd_, op, fd, &ev) < 0) {
+                return false;
+            }
+        }
+        state.events_ = events;
+        state.added_ = true;
+        return true;
+    }
+
+    // a level-triggered fd fires again for the waiters left queued once re-armed
+    void wake(std::vector<std::coroutine_handle<>>& queue, bool all) {
+        if (queue.empty()) {
+            return;
+        }
+        if (all) {
+            for (auto handle : queue) {
+                make_ready(handle);
+            }
+            queue.clear();
+        } else {
+            make_ready(queue.front());
+            queue.erase(queue.begin());
+        }
+    }
+
+    void make_ready(std::coroutine_handle<> handle) {
+        waiters_.erase(handle.address());
+        ready_.push_back(handle);
+    }
+
+    static constexpr int max_events = 64;
+
+    int epfd_;
+    int wakeup_fd_{-1};
+    size_t pending_{0};
+    std::unordered_map<int, FdState> fds_;
+    std::unordered_map<void*, int> waiters_;
+    std::deque<std::coroutine_handle<>> ready_;
+    epoll_event events_[max_events];
+};
+
+// IO helpers for coroutines running on an EpollScheduler. The syscall is tried first and
+// the coroutine only waits when it would block. Return the syscall result or -errno,
+// -ECANCELED if the wait was cancelled.
+
+inline Async<ssize_t> async_read(int fd, void* buf, size_t count,
+                                 bool edge_triggered = false) {
+    while (true) {
+        ssize_t n = ::read(fd, buf, count);
+        if (n >= 0) co_return n;
+        if (errno == EINTR) continue;
+        if (errno != EAGAIN && errno != EWOULDBLOCK) co_return -errno;
+        bool ready =
+            co_await IOAwaiter<IOEvent>{IOEvent{fd, IOInterest::READ, edge_triggered}};
+        if (!ready) {
+            co_return -ECANCELED;
+        }
+    }
+}
+
+inline Async<ssize_t> async_write(int fd, const void* buf, size_t count,
+                                  bool edge_triggered = false) {
+    while (true) {
+        ssize_t n = ::write(fd, buf, count);
+        if (n >= 0) co_return n;
+        if (errno == EINTR) continue;
+        if (errno != EAGAIN && errno != EWOULDBLOCK) co_return -errno;
+        bool ready =
+            co_await IOAwaiter<IOEvent>{IOEvent{fd, IOInterest::WRITE, edge_triggered}};
+        if (!ready) {
+            co_return -ECANCELED;
+        }
+    }
+}
+
+// the accepted socket is non-blocking and close-on-exec
+inline Async<int> async_accept(int fd, sockaddr* addr = nullptr,
+                               socklen_t* addrlen = nullptr,
+                               bool edge_triggered = false) {
+    while (true) {
+        int conn = ::accept4(fd, addr, addrlen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (conn >= 0) co_return conn;
+        if (errno == EINTR || errno == ECONNABORTED) continue;
+        if (errno != EAGAIN && errno != EWOULDBLOCK) co_return -errno;
+        bool ready =
+            co_await IOAwaiter<IOEvent>{IOEvent{fd, IOInterest::READ, edge_triggered}};
+        if (!ready) {
+            co_return -ECANCELED;
+        }
+    }
+}
+
+}  // namespace shcoro
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <system_error>
+#include <tuple>
+
+#include "epoll_scheduler.hpp"
+#include "fifo_scheduler.hpp"
+#include "promise_concepts.hpp"
+#include "scheduler_node.hpp"
+#include "shcoro/utils/exception.h"
+#include "shcoro/utils/logger.h"
+#include "shcoro/utils/mpsc_queue.h"
+#include "shcoro/utils/noncopyable.h"
+#include "timer.hpp"
+#include "timing_wheel.hpp"
+
+namespace shcoro {
+// Single threaded loop driving a ready queue, a timing wheel and an epoll poller.
+// Registrations are routed on the awaiter value: none (FIFOAwaiter) goes to the ready
+// queue, std::chrono::nanoseconds (TimedAwaiter) to the timers and IOEvent (async_read,
+// async_write, async_accept) to the poller.
+// One iteration resumes the coroutines that were ready when it started, expires due
+// timers and polls IO. It only blocks in epoll_wait, until the next timer at the latest,
+// when nothing is ready.
+// Other threads hand coroutines over with post() or co_await loop.schedule_on(), through
+// a lock-free MPSC queue and an eventfd that wakes up the poll.
+class EventLoop : noncopyable {
+    struct RemoteNode : MPSCNode {
+        std::coroutine_handle<> handle_{};
+        bool owned_{false};  // allocated by post(handle)
+    };
+
+   public:
+    using value_types = std::tuple<std::chrono::nanoseconds, IOEvent>;
+
+    // co_await loop.schedule_on() continues the coroutine on the loop thread, which also
+    // becomes the scheduler of the coroutine
+    struct ScheduleOnAwaiter {
+        constexpr bool await_ready() const noexcept { return false; }
+
+        template <typename CallerPromiseType>
+        void await_suspend(std::coroutine_handle<CallerPromiseType> caller) noexcept {
+            if constexpr (PromiseSchedulerConcept<CallerPromiseType>) {
+                caller.promise().set_scheduler(*loop_);
+            }
+            node_.handle_ = caller;
+            loop_->post(node_);
+        }
+
+        void await_resume() const noexcept {}
+
+        EventLoop* loop_;
+        RemoteNode node_{};
+    };
+
+    explicit EventLoop(std::chrono::nanoseconds timer_tick = std::chrono::milliseconds(1))
+        : timers_(timer_tick), wakeup_fd_(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+        if (wakeup_fd_ < 0) {
+            detail::throw_exception(
+                std::system_error(errno, std::system_category(), "eventfd"));
+        }
+        io_.set_wakeup_fd(wakeup_fd_);
+    }
+
+    ~EventLoop() {
+        while (auto* node = static_cast<RemoteNode*>(remote_.pop())) {
+            if (node->owned_) delete node;
+        }
+        ::close(wakeup_fd_);
+    }
+
+    // thread safe, handle is resumed on the loop thread
+    void post(std::coroutine_handle<> handle) {
+        auto* node = new RemoteNode{};
+        node->handle_ = handle;
+        node->owned_ = true;
+        post(*node);
+    }
+
+    ScheduleOnAwaiter schedule_on() noexcept { return ScheduleOnAwaiter{this}; }
+
+    // thread safe, makes run_forever() return
+    void stop() {
+        stop_.store(true, std::memory_order_release);
+        wakeup();
+    }
+
+    void register_node(SchedulerNode& node) {
+        // tells unregister_node which list the node is linked into
+        node.key_ = ready_key;
+        ready_.register_node(node);
+    }
+
+    void register_coro(std::coroutine_handle<> coro) { ready_.register_coro(coro); }
+
+    void register_node(SchedulerNode& node, std::chrono::nanoseconds duration) {
+        timers_.register_node(node, duration);
+    }
+
+    void register_coro(std::coroutine_handle<> coro, std::chrono::nanoseconds duration) {
+        timers_.register_coro(coro, duration);
+    }
+
+    void register_coro(std::coroutine_handle<> coro, const IOEvent& event) {
+        io_.register_coro(coro, event);
+    }
+
+    // see EpollScheduler::forget
+    void forget(int fd) { io_.forget(fd); }
+
+    bool unregister_node(SchedulerNode& node) {
+        if (node.linked()) {
+            if (node.key_ == ready_key) {
+                return ready_.unregister_node(node);
+            }
+            return timers_.unregister_node(node);
+        }
+        return unregister_coro(node.handle_);
+    }
+
+    // a coroutine waits in at most one of them
+    bool unregister_coro(std::coroutine_handle<> coro) {
+        return ready_.unregister_coro(coro) || timers_.unregister_coro(coro) ||
+               io_.unregister_coro(coro);
+    }
+
+    // one iteration, blocks in the IO poll if block is set and nothing is ready
+    void run_once(bool block = false) { step(block, false); }
+
+    // runs until nothing is pending, coroutines that are still to be posted by other
+    // threads do not count
+    void run() {
+        while (pending_number() != 0) {
+            step(true, false);
+        }
+    }
+
+    // runs until stop() is called, waiting for posts when idle
+    void run_forever() {
+        while (!stop_.load(std::memory_order_acquire)) {
+            step(true, true);
+        }
+        stop_.store(false, std::memory_order_relaxed);
+    }
+
+    size_t pending_number() const {
+        return ready_.pending_number() + timers_.pending_number() + io_.pending_number();
+    }
+
+   private:
+    // timing wheel expiry ticks never get that far
+    static constexpr uint64_t ready_key = ~uint64_t{0};
+
+    void post(RemoteNode& node) {
+        SHCORO_LOG("event loop post: ", node.handle_.address());
+        remote_.push(&node);
+        // one eventfd write per batch, the loop clears the flag before it sleeps
+        if (!notified_.exchange(true, std::memory_order_seq_cst)) {
+            wakeup();
+        }
+    }
+
+    void wakeup() {
+        uint64_t one = 1;
+        (void)::write(wakeup_fd_, &one, sizeof(one));
+    }
+
+    void drain_remote() {
+        while (auto* node = static_cast<RemoteNode*>(remote_.pop())) {
+            auto handle = node->handle_;
+            if (node->owned_) delete node;
+            SHCORO_LOG("event loop resume posted handle: ", handle.address());
+            handle.resume();
+        }
+    }
+
+    void step(bool block, bool wait_for_post) {
+        drain_remote();
+
+        // coroutines queued while draining wait for the next iteration so that IO and
+        // timers are not starved
+        for (size_t n = ready_.pending_number(); n != 0 && ready_.pending_number() != 0;
+             n--) {
+            ready_.run_once();
+        }
+        timers_.run_once();
+
+        int timeout = block ? poll_timeout(wait_for_post) : 0;
+        if (timeout != 0) {
+            notified_.store(false, std::memory_order_seq_cst);
+            if (!remote_.empty() || stop_.load(std::memory_order_acquire)) {
+                timeout = 0;
+            }
+        }
+        io_.poll(timeout);
+    }
+
+    int poll_timeout(bool wait_for_post) const {
+        if (ready_.pending_number() != 0) {
+            return 0;
+        }
+        auto expiry = timers_.next_expiry();
+        if (!expiry) {
+            // nothing but IO can make progress
+            return io_.pending_number() != 0 || wait_for_post ? -1 : 0;
+        }
+        // rounded up, waking up before the timer is due would spin
+        auto wait = *expiry - TimingWheelScheduler::clock::now();
+        auto ms = std::chrono::ceil<std::chrono::milliseconds>(wait).count();
+        return ms > 0 ? static_cast<int>(ms) : 0;
+    }
+
+    IntrusiveFIFOScheduler ready_;
+    TimingWheelScheduler timers_;
+    EpollScheduler io_;
+
+    int wakeup_fd_;
+    MPSCQueue remote_;
+    std::atomic<bool> notified_{false};
+    std::atomic<bool> stop_{false};
+};
+
+}  // namespace shcoro
@@ -6,6 +6,7 @@
 #include "promise_concepts.hpp"
 #include "shcoro/stackless/scheduler_awaiter.hpp"
 #include "shcoro/utils/logger.h"
+#include "shcoro/utils/noncopyable.h"
 
 namespace shcoro {
 class FIFOScheduler {
@@ -16,13 +17,16 @@ class FIFOScheduler {
         coro_map_[coro.address()] = it;
     }
 
-    void unregister_coro(std::coroutine_handle<> coro) {
-        auto addr = coro.address();
-        if (coro_map_.find(addr) != coro_map_.end()) {
-            SHCORO_LOG("fifo unregister: ", addr);
-            coros_.erase(coro_map_[addr]);
-            coro_map_.erase(addr);
+    // true if coro was queued, it will not be resumed then
+    bool unregister_coro(std::coroutine_handle<> coro) {
+        auto it = coro_map_.find(coro.address());
+        if (it == coro_map_.end()) {
+            return false;
         }
+        SHCORO_LOG("fifo unregister: ", coro.address());
+        coros_.erase(it->second);
+        coro_map_.erase(it);
+        return true;
     }
 
     void run_once() {
@@ -54,6 +58,86 @@ class FIFOScheduler {
     std::unordered_map<void*, decltype(coros_)::iterator> coro_map_;
 };
 
+// FIFO scheduler queueing the SchedulerNode embedded in the promise:
+// register, unregister and pop are O(1) and never allocate.
+// Handles registered without a node fall back to a heap allocated one.
+class IntrusiveFIFOScheduler : noncopyable {
+   public:
+    ~IntrusiveFIFOScheduler() {
+        while (!ready_.empty()) {
+            foreign_.release(ready_.pop_front());
+        }
+    }
+
+    void register_node(SchedulerNode& node) {
+        SHCORO_LOG("intrusive fifo register: ", node.handle_.address());
+        ready_.push_back(node);
+        pending_++;
+    }
+
+    bool unregister_node(SchedulerNode& node) {
+        if (node.linked()) {
+            SHCORO_LOG("intrusive fifo unregister: ", node.handle_.address());
+            node.unlink();
+            pending_--;
+            return true;
+        }
+        return !foreign_.empty() && unregister_coro(node.handle_);
+    }
+
+    void register_coro(std::coroutine_handle<> coro) {
+        SHCORO_LOG("intrusive fifo register foreign: ", coro.address());
+        // registered again while queued, it moves to the back
+        auto& node = foreign_.acquire(coro);
+        if (node.linked()) {
+            node.unlink();
+            pending_--;
+        }
+        register_node(node);
+    }
+
+    bool unregister_coro(std::coroutine_handle<> coro) {
+        auto* node = foreign_.find(coro);
+        if (!node) {
+            return false;
+        }
+        SHCORO_LOG("intrusive fifo unregister foreign: ", coro.address());
+        node->unlink();
+        pending_--;
+        foreign_.release(*node);
+        return true;
+    }
+
+    void run_once() {
+        if (!ready_.empty()) {
+            resume_front();
+        }
+    }
+
+    void run() {
+        while (!ready_.empty()) {
+            resume_front();
+        }
+    }
+
+    size_t pending_number() const { return pending_; }
+
+   private:
+    void resume_front() {
+        SHCORO_LOG("remaining task: ", pending_);
+        auto& node = ready_.pop_front();
+        pending_--;
+        auto handle = node.handle_;
+        foreign_.release(node);
+        SHCORO_LOG("resume handle: ", handle.address());
+        handle.resume();
+    }
+
+    SchedulerNodeList ready_;
+    size_t pending_{0};
+    ForeignSchedulerNodes foreign_;
+};
+
 using FIFOAwaiter = SchedulerAwaiter<void>;
 
 }  // namespace shcoro
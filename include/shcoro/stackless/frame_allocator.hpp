@@ -0,0 +1,202 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+namespace shcoro {
+
+// Coroutine frame allocation.
+// Every frame carries a trailer after the frame itself that records how to free it:
+//   [ frame (size) | deallocate fn | allocator (allocator_arg_t frames only) ]
+// Frames without an allocator come from per-thread size-class freelists (64 to 4096
+// bytes), bigger frames go to the global operator new. A frame may be freed on any
+// thread, the block is then cached by the freeing thread.
+// Define SHCORO_DISABLE_FRAME_POOL to always use the global operator new.
+namespace detail {
+
+using frame_deallocate_fn = void (*)(void* frame, size_t size) noexcept;
+
+constexpr size_t align_up(size_t size, size_t align) noexcept {
+    return (size + align - 1) & ~(align - 1);
+}
+
+constexpr size_t frame_trailer_offset(size_t size) noexcept {
+    return align_up(size, alignof(frame_deallocate_fn));
+}
+
+constexpr size_t frame_total_size(size_t size) noexcept {
+    return frame_trailer_offset(size) + sizeof(frame_deallocate_fn);
+}
+
+inline frame_deallocate_fn& frame_trailer(void* frame, size_t size) noexcept {
+    return *reinterpret_cast<frame_deallocate_fn*>(static_cast<std::byte*>(frame) +
+                                                   frame_trailer_offset(size));
+}
+
+class FramePool {
+   public:
+    static constexpr size_t min_shift = 6;  // 64 bytes
+    static constexpr size_t max_shift = 12;  // 4096 bytes
+    static constexpr size_t class_num = max_shift - min_shift + 1;
+    static constexpr size_t max_cached = 256;  // per size class
+
+    static void* allocate(size_t size) {
+        size_t total = frame_total_size(size);
+        void* frame = nullptr;
+#ifndef SHCORO_DISABLE_FRAME_POOL
+        if (total <= (size_t{1} << max_shift)) {
+            frame = allocate_block(size_class(total));
+            frame_trailer(frame, size) = &deallocate_pooled;
+            return frame;
+        }
+#endif
+        frame = ::operator new(total);
+        frame_trailer(frame, size) = &deallocate_global;
+        return frame;
+    }
+
+   private:
+    struct FreeBlock {
+        FreeBlock* next_;
+    };
+
+    // trivially destructible so it stays usable while other thread_locals are torn down
+    struct Cache {
+        FreeBlock* heads_[class_num];
+        uint32_t counts_[class_num];
+        bool destroyed_;
+    };
+
+    struct CacheCleaner {
+        ~CacheCleaner() {
+            auto& c = cache();
+            for (size_t i = 0; i < class_num; i++) {
+                while (c.heads_[i]) {
+                    auto* block = c.heads_[i];
+                    c.heads_[i] = block->next_;
+                    ::operator delete(block);
+                }
+                c.counts_[i] = 0;
+            }
+            c.destroyed_ = true;
+        }
+    };
+
+    static Cache& cache() noexcept {
+        static thread_local Cache c{};
+        return c;
+    }
+
+    static size_t size_class(size_t total) noexcept {
+        size_t index = 0;
+        while ((size_t{1} << (min_shift + index)) < total) index++;
+        return index;
+    }
+
+    static void* allocate_block(size_t index) {
+        auto& c = cache();
+        if (auto* block = c.heads_[index]) {
+            c.heads_[index] = block->next_;
+            c.counts_[index]--;
+            return block;
+        }
+        return ::operator new(size_t{1} << (min_shift + index));
+    }
+
+    static void deallocate_pooled(void* frame, size_t size) noexcept {
+        size_t index = size_class(frame_total_size(size));
+        auto& c = cache();
+        if (c.destroyed_ || c.counts_[index] >= max_cached) {
+            ::operator delete(frame);
+            return;
+        }
+        static thread_local CacheCleaner cleaner;
+        (void)cleaner;
+        auto* block = static_cast<FreeBlock*>(frame);
+        block->next_ = c.heads_[index];
+        c.heads_[index] = block;
+        c.counts_[index]++;
+    }
+
+    static void deallocate_global(void* frame, size_t) noexcept {
+        ::operator delete(frame);
+    }
+};
+
+template <typename Alloc>
+struct AllocatorFrame {
+    // rebind to a block type so that user allocators keep the default new alignment
+    struct alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) block {
+        std::byte data_[__STDCPP_DEFAULT_NEW_ALIGNMENT__];
+    };
+    using block_alloc =
+        typename std::allocator_traits<Alloc>::template rebind_alloc<block>;
+    using block_traits = std::allocator_traits<block_alloc>;
+
+    static_assert(alignof(block_alloc) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+
+    static size_t alloc_offset(size_t size) noexcept {
+        return align_up(frame_total_size(size), alignof(block_alloc));
+    }
+
+    static size_t block_num(size_t size) noexcept {
+        return align_up(alloc_offset(size) + sizeof(block_alloc), sizeof(block)) /
+               sizeof(block);
+    }
+
+    static block_alloc* stored_alloc(void* frame, size_t size) noexcept {
+        return reinterpret_cast<block_alloc*>(static_cast<std::byte*>(frame) +
+                                              alloc_offset(size));
+    }
+
+    static void* allocate(size_t size, const Alloc& alloc) {
+        block_alloc balloc(alloc);
+        void* frame = std::to_address(block_traits::allocate(balloc, block_num(size)));
+        frame_trailer(frame, size) = &deallocate;
+        ::new (static_cast<void*>(stored_alloc(frame, size)))
+            block_alloc(std::move(balloc));
+        return frame;
+    }
+
+    static void deallocate(void* frame, size_t size) noexcept {
+        auto* stored = stored_alloc(frame, size);
+        block_alloc balloc(std::move(*stored));
+        stored->~block_alloc();
+        block_traits::deallocate(balloc, static_cast<block*>(frame), block_num(size));
+    }
+};
+
+}  // namespace detail
+
+// Pooled coroutine frames. A coroutine taking (std::allocator_arg_t, const Alloc&, ...)
+// as its leading parameters (after the object parameter for member coroutines)
+// allocates its frame from that allocator instead.
+// GCC 12 flags such coroutines with -Wmismatched-new-delete: it never pairs a member
+// operator new template with a non-template operator delete, while a frame can only be
+// freed through the non-template one. The sized delete below frees both kinds of frames.
+// The warning is reported at the user's coroutine, where a pragma here has no effect,
+// so the shcoro CMake target turns it off for its consumers instead.
+struct promise_allocator_base {
+    static void* operator new(size_t size) { return detail::FramePool::allocate(size); }
+
+    template <typename Alloc, typename... Args>
+    static void* operator new(size_t size, std::allocator_arg_t, const Alloc& alloc,
+                              const Args&...) {
+        return detail::AllocatorFrame<Alloc>::allocate(size, alloc);
+    }
+
+    template <typename This, typename Alloc, typename... Args>
+    static void* operator new(size_t size, const This&, std::allocator_arg_t,
+                              const Alloc& alloc, const Args&...) {
+        return detail::AllocatorFrame<Alloc>::allocate(size, alloc);
+    }
+
+    static void operator delete(void* frame, size_t size) noexcept {
+        detail::frame_trailer(frame, size)(frame, size);
+    }
+};
+
+}  // namespace shcoro
@@ -1,58 +1,133 @@
 #pragma once
 
 #include <coroutine>
+#include <cstddef>
 #include <exception>
 #include <iterator>
+#include <memory>
+#include <ranges>
 #include <type_traits>
+#include <utility>
+
+#include "promise_base.hpp"
 
 namespace shcoro {
 
+// co_yield elements_of(range) yields every element of range in turn
+template <typename R>
+struct elements_of {
+    R range_;
+};
+
+template <typename R>
+elements_of(R&&) -> elements_of<R&&>;
+
+// Generator<T> hands out const T&, Generator<T&> / Generator<const T&> the yielded
+// lvalue itself. The promise only keeps a pointer to the yielded object, which lives
+// until the generator is resumed (a temporary until the end of the co_yield expression),
+// so nothing is copied per element.
+// A Generator is an input view, it can be piped into std::views adaptors.
+// co_yield elements_of(gen) runs a nested generator as the leaf of a stack rooted at the
+// outermost one: the iterator resumes the leaf directly and a finished leaf transfers
+// control to its parent, so an element costs O(1) whatever the nesting depth.
 template <typename T>
-class Generator {
+class Generator : public std::ranges::view_interface<Generator<T>> {
    public:
-    struct promise_type {
+    using value_type = std::remove_cvref_t<T>;
+    using reference = std::conditional_t<std::is_reference_v<T>, T, const T&>;
+
+    struct promise_type : promise_exception_base {
+        using coroutine_handle_t = std::coroutine_handle<promise_type>;
+
+        // a finished nested generator continues its parent, the root returns to the
+        // iterator
+        struct FinalAwaiter {
+            constexpr bool await_ready() const noexcept { return false; }
+            std::coroutine_handle<> await_suspend(coroutine_handle_t h) noexcept {
+                auto& promise = h.promise();
+                if (promise.parent_) {
+                    promise.root_->leaf_ = promise.parent_;
+                    return promise.parent_;
+                }
+                return std::noop_coroutine();
+            }
+            constexpr void await_resume() const noexcept {}
+        };
+
+        struct NestedAwaiter {
+            constexpr bool await_ready() const noexcept { return false; }
+
+            std::coroutine_handle<> await_suspend(coroutine_handle_t parent) noexcept {
+                auto child = nested_.handle_;
+                auto* root = parent.promise().root_;
+                child.promise().root_ = root;
+                child.promise().parent_ = parent;
+                root->leaf_ = child;
+                return child;
+            }
+
+            // an exception leaving the nested generator continues in the parent
+            void await_resume() { nested_.handle_.promise().rethrow_if_exception(); }
+
+            Generator nested_;
+        };
+
+        promise_type() : leaf_(coroutine_handle_t::from_promise(*this)) {}
+
         auto get_return_object() { return Generator<T>{this}; }
         std::suspend_always initial_suspend() noexcept { return {}; }
-        std::suspend_always final_suspend() noexcept { return {}; }
-        template <typename V>
-        std::suspend_always yield_value(V&& val) {
-            value_ = std::forward<V>(val);
+        FinalAwaiter final_suspend() noexcept { return {}; }
+        std::suspend_always yield_value(reference val) noexcept {
+            root_->value_ = std::addressof(val);
             return {};
         }
-        void unhandled_exception() { exception_ = std::current_exception(); }
 
-        const T& value() const { return value_; }
+        NestedAwaiter yield_value(elements_of<Generator&&> nested) noexcept {
+            return NestedAwaiter{std::move(nested.range_)};
+        }
 
-        void rethrow_if_exception() {
-            if (exception_) {
-                std::rethrow_exception(exception_);
-            }
+        // any other range is walked by a nested generator
+        template <std::ranges::input_range R>
+        NestedAwaiter yield_value(elements_of<R> range) {
+            auto walk = [](R r) -> Generator {
+                for (auto&& element : r) {
+                    co_yield element;
+                }
+            };
+            return NestedAwaiter{walk(std::forward<R>(range.range_))};
         }
 
+        void return_void() const noexcept {}
+
+        reference value() const { return static_cast<reference>(*value_); }
+
+        // resumes the innermost running generator, only called on the root
+        void resume() { leaf_.resume(); }
+
        private:
-        T value_{};
-        std::exception_ptr exception_{nullptr};
+        std::add_pointer_t<reference> value_{nullptr};
+        promise_type* root_{this};
+        coroutine_handle_t parent_{nullptr};
+        coroutine_handle_t leaf_;
     };
 
    private:
     using coroutine_handle_t = std::coroutine_handle<promise_type>;
-    struct sentinel {};
 
     struct iterator {
+        using value_type = Generator::value_type;
+        using difference_type = std::ptrdiff_t;
+
         iterator() {}
 
         explicit iterator(coroutine_handle_t coroutine) : handle_(coroutine) {}
 
-        friend bool operator==(const iterator& it, sentinel) {
+        friend bool operator==(const iterator& it, std::default_sentinel_t) {
             return it.handle_ == nullptr || it.handle_.done();
         }
-        friend bool operator==(sentinel s, const iterator& it) { return (it == s); }
-
-        friend bool operator!=(const iterator& it, sentinel s) { return !(it == s); }
-        friend bool operator!=(sentinel s, const iterator& it) { return it != s; }
 
         iterator& operator++() {
-            handle_.resume();
+            handle_.promise().resume();
             if (handle_.done()) [[unlikely]] {
                 handle_.promise().rethrow_if_exception();
             }
@@ -61,9 +136,9 @@ class Generator {
 
         void operator++(int) { (void)operator++(); }
 
-        const T& operator*() const { return handle_.promise().value(); }
+        reference operator*() const { return handle_.promise().value(); }
 
-        const T* operator->() const { return std::addressof(operator*()); }
+        auto operator->() const { return std::addressof(operator*()); }
 
        private:
         coroutine_handle_t handle_{nullptr};
@@ -73,12 +148,15 @@ class Generator {
     Generator(const Generator&) = delete;
     Generator& operator=(const Generator&) = delete;
 
-    Generator(Generator&& other) noexcept : handle_(other.handle_) {
-        other.handle_ = nullptr;
-    }
+    Generator(Generator&& other) noexcept
+        : handle_(std::exchange(other.handle_, nullptr)) {}
     Generator& operator=(Generator&& other) noexcept {
-        handle_ = other.handle_;
-        other.handle_ = nullptr;
+        if (this != &other) {
+            if (handle_) {
+                handle_.destroy();
+            }
+            handle_ = std::exchange(other.handle_, nullptr);
+        }
         return *this;
     }
 
@@ -90,7 +168,7 @@ class Generator {
 
     auto begin() {
         if (handle_ != nullptr) {
-            handle_.resume();
+            handle_.promise().resume();
             if (handle_.done()) [[unlikely]] {
                 handle_.promise().rethrow_if_exception();
             }
@@ -98,7 +176,7 @@ class Generator {
         return iterator{handle_};
     }
 
-    auto end() { return sentinel{}; }
+    auto end() const noexcept { return std::default_sentinel; }
 
    private:
     explicit Generator(promise_type* promise) {
@@ -108,4 +186,4 @@ class Generator {
     coroutine_handle_t handle_{nullptr};
 };
 
-}  // namespace shcoro
\ No newline at end of file
+}  // namespace shcoro
@@ -3,23 +3,31 @@
 #include <coroutine>
 
 #include "promise_concepts.hpp"
+#include "scheduler_awaiter.hpp"
 #include "shcoro/utils/logger.h"
 
 namespace shcoro {
+// await_resume() is false if the wait was cancelled and the request withdrawn. On
+// schedulers that cancel the request instead (UringScheduler) it stays true, the request
+// then completes with its own result.
 template <typename IOHandle>
-struct IOAwaiter {
+struct IOAwaiter : CancellableWait {
     IOAwaiter(const IOHandle& handle) : io_handle_(handle) {}
     IOAwaiter(IOHandle&& handle) : io_handle_(std::move(handle)) {}
 
     constexpr bool await_ready() const noexcept { return false; }
 
     template <shcoro::PromiseSchedulerConcept CallerPromiseType>
-    auto await_suspend(std::coroutine_handle<CallerPromiseType> caller) noexcept {
-        scheduler_register_coro(caller.promise().get_scheduler(), caller,
-                                std::move(io_handle_));
+    bool await_suspend(std::coroutine_handle<CallerPromiseType> caller) noexcept {
+        auto& sched = caller.promise().get_scheduler();
+        if (cancellation_requested(caller) || !watch_cancellation(caller, sched, nullptr)) {
+            return yield_cancelled(caller, sched, nullptr);
+        }
+        scheduler_register_coro(sched, caller, std::move(io_handle_));
+        return true;
     }
 
-    void await_resume() const noexcept {}
+    [[nodiscard]] bool await_resume() noexcept { return finish_wait(); }
 
     IOHandle io_handle_;
 };
@@ -1,28 +1,48 @@
 #pragma once
 
 #include <coroutine>
-#include <queue>
 
 #include "shcoro/utils/noncopyable.h"
+#include "waiter.hpp"
 
 namespace shcoro {
+// Single threaded coroutine mutex. Ownership is handed to the oldest waiter on unlock,
+// which is resumed inline or, with WakeupPolicy::RESCHEDULE, registered into its
+// scheduler so that the unlocker keeps running and long chains do not grow its stack.
 class MutexLock final : noncopyable {
    public:
-    struct MutexAwaiter {
+    struct MutexAwaiter : Waiter {
         MutexAwaiter(MutexLock* mutex) : mutex_(mutex) {}
 
-        bool await_ready() noexcept { return !mutex_->locked_; }
+        bool await_ready() noexcept { return mutex_->try_lock(); }
 
-        void await_suspend(std::coroutine_handle<> caller) {
-            mutex_->waiting_list_.push(caller);
+        template <typename CallerPromiseType>
+        bool await_suspend(std::coroutine_handle<CallerPromiseType> caller) noexcept {
+            set_waiter(caller);
+            if (!watch_cancellation(&on_cancel, this)) {
+                return yield_cancelled();
+            }
+            mutex_->waiting_list_.push(*this);
+            return true;
         }
 
-        void await_resume() noexcept { mutex_->locked_ = true; }
+        // the lock was taken in await_ready or handed over by unlock, false if the wait
+        // was cancelled and the lock is not held
+        [[nodiscard]] bool await_resume() noexcept { return !cancelled_; }
+
+        static void on_cancel(void* self) {
+            auto& awaiter = *static_cast<MutexAwaiter*>(self);
+            if (awaiter.mutex_->waiting_list_.remove(awaiter)) {
+                awaiter.cancel();
+            }
+        }
 
         MutexLock* mutex_{nullptr};
+        MutexAwaiter* next_{nullptr};
     };
 
-    MutexLock() = default;
+    explicit MutexLock(WakeupPolicy policy = WakeupPolicy::INLINE) noexcept
+        : policy_(policy) {}
     MutexLock(MutexLock&& other) noexcept = default;
     ~MutexLock() = default;
 
@@ -36,16 +56,29 @@ class MutexLock final : noncopyable {
 
     void unlock() {
         if (!waiting_list_.empty()) {
-            auto nxt = waiting_list_.front();
-            waiting_list_.pop();
-            nxt.resume();
+            // stays locked, the awaiter lives in the waiter frame and is gone once woken
+            waiting_list_.pop().wake(policy_);
         } else {
             locked_ = false;
         }
     }
 
+    using ScopedLock = ScopedLockGuard<MutexLock, &MutexLock::unlock>;
+
+    struct ScopedMutexAwaiter : MutexAwaiter {
+        using MutexAwaiter::MutexAwaiter;
+        ScopedLock await_resume() noexcept {
+            return cancelled_ ? ScopedLock() : ScopedLock(*mutex_);
+        }
+    };
+
+    // co_await mutex.scoped_lock() returns a guard that unlocks on destruction, an empty
+    // one if the wait was cancelled
+    [[nodiscard]] ScopedMutexAwaiter scoped_lock() { return ScopedMutexAwaiter(this); }
+
    private:
-    std::queue<std::coroutine_handle<>> waiting_list_;
+    WaiterQueue<MutexAwaiter> waiting_list_;
     bool locked_ = false;
+    WakeupPolicy policy_;
 };
-}  // namespace shcoro
\ No newline at end of file
+}  // namespace shcoro
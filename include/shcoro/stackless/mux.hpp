@@ -1,9 +1,10 @@
 #pragma once
 
-#include <functional>
-#include <vector>
+#include <coroutine>
+#include <cstddef>
 
 #include "async.hpp"
+#include "mux_control.hpp"
 #include "traits.h"
 
 namespace shcoro {
@@ -21,22 +22,13 @@ class [[nodiscard]] Mux : noncopyable {
                           promise_return_base<T>,
                           promise_caller_base,
                           promise_scheduler_base,
-                          promise_exception_base {
+                          promise_cancellation_base,
+                          promise_exception_base,
+                          promise_allocator_base {
         promise_type() { SHCORO_LOG("mux promise created: ", this); }
         ~promise_type() { SHCORO_LOG("mux promise destroyed: ", this); }
 
         auto get_return_object() { return Mux{this}; }
-
-        void set_resume_limit(size_t num) noexcept { resume_limit_ = num; }
-        void finish_one() noexcept { finish_count_++; }
-        bool resumable() const noexcept { return finish_count_ >= resume_limit_; }
-        void log_progress() const {
-            SHCORO_LOG("mux progress: ", finish_count_, "/", resume_limit_);
-        }
-
-       protected:
-        size_t finish_count_{0};
-        size_t resume_limit_{0};
     };
 
     constexpr bool await_ready() const noexcept { return false; }
@@ -47,6 +39,13 @@ class [[nodiscard]] Mux : noncopyable {
         if constexpr (PromiseSchedulerConcept<CallerPromiseType>) {
             self_.promise().set_scheduler(caller.promise().get_scheduler());
         }
+        if constexpr (PromiseCancellationConcept<CallerPromiseType>) {
+            // a token set on the task itself takes precedence
+            if (!self_.promise().get_cancellation_token().can_be_cancelled()) {
+                self_.promise().set_cancellation_token(
+                    caller.promise().get_cancellation_token());
+            }
+        }
         return self_;
     }
 
@@ -54,6 +53,7 @@ class [[nodiscard]] Mux : noncopyable {
         requires(!std::is_same_v<T, void>)
     {
         SHCORO_LOG("mux await resumed: ", &self_.promise());
+        self_.promise().rethrow_if_exception();
         return std::move(this->self_.promise().get_return_value());
     }
 
@@ -61,9 +61,13 @@ class [[nodiscard]] Mux : noncopyable {
         requires(std::is_same_v<T, void>)
     {
         SHCORO_LOG("mux await resumed: ", &self_.promise());
+        self_.promise().rethrow_if_exception();
     }
 
     void set_scheduler(Scheduler sched) noexcept { self_.promise().set_scheduler(sched); }
+    void set_cancellation_token(CancellationToken token) noexcept {
+        self_.promise().set_cancellation_token(token);
+    }
 
     Mux(Mux&& other) noexcept : self_(std::exchange(other.self_, {})) {}
 
@@ -88,29 +92,32 @@ template <typename T>
 class [[nodiscard]] MuxAdapter : noncopyable {
    public:
     using value_type = T;
-    using resume_mux_callback = std::function<std::coroutine_handle<>(replace_void_t<T>)>;
 
     struct ResumeMuxAwaiter;
 
     struct promise_type : promise_suspend_base<std::suspend_always, ResumeMuxAwaiter>,
                           promise_return_base<T>,
-                          promise_exception_base {
-        promise_type() {
-            SHCORO_LOG("mux adapter promise created: ", this);
-            resume_mux_cb_ = [](replace_void_t<T>) -> std::coroutine_handle<> {
-                SHCORO_LOG("default resume mux cb called");
-                return std::noop_coroutine();
-            };
-        }
+                          promise_exception_base,
+                          promise_cancellation_base,
+                          promise_allocator_base {
+        promise_type() { SHCORO_LOG("mux adapter promise created: ", this); }
         ~promise_type() { SHCORO_LOG("mux adapter promise destroyed: ", this); }
 
         auto get_return_object() { return MuxAdapter{this}; }
 
-        void set_resume_mux_callback(auto&& cb) { resume_mux_cb_ = cb; }
-        auto get_resume_mux_callback() const { return resume_mux_cb_; }
+        void set_control(MuxControl* control, size_t index) noexcept {
+            control_ = control;
+            index_ = index;
+        }
+
+        // without a control block the adapter just stops at its final suspend
+        std::coroutine_handle<> finish() noexcept {
+            return control_ ? control_->finish(index_) : std::noop_coroutine();
+        }
 
        protected:
-        resume_mux_callback resume_mux_cb_;
+        MuxControl* control_{nullptr};
+        size_t index_{0};
     };
 
     struct ResumeMuxAwaiter {
@@ -118,19 +125,14 @@ class [[nodiscard]] MuxAdapter : noncopyable {
         constexpr void await_resume() const noexcept { /* should never be called */ }
         std::coroutine_handle<> await_suspend(
             std::coroutine_handle<promise_type> h) const noexcept {
-            SHCORO_LOG("mux adapter final suspense and call resume cb: ", &h.promise());
-            if constexpr (!std::is_same_v<T, void>) {
-                SHCORO_LOG("none void cb");
-                return h.promise().get_resume_mux_callback()(
-                    std::move(h.promise().get_return_value()));
-            } else {
-                SHCORO_LOG("void cb");
-                return h.promise().get_resume_mux_callback()(replace_void_t<T>{});
-            }
+            SHCORO_LOG("mux adapter final suspend: ", &h.promise());
+            return h.promise().finish();
         }
     };
 
+    // rethrows an exception that escaped the adapted task
     auto get() const {
+        self_.promise().rethrow_if_exception();
         if constexpr (!std::is_same_v<T, void>) {
             return self_.promise().get_return_value();
         } else {
@@ -139,9 +141,17 @@ class [[nodiscard]] MuxAdapter : noncopyable {
     }
 
     auto get_self() const noexcept { return self_; }
+    bool has_exception() const noexcept { return self_.promise().has_exception(); }
+    void rethrow_if_exception() const { self_.promise().rethrow_if_exception(); }
+
+    // index is reported to control when the adapted task finishes
+    void set_control(MuxControl* control, size_t index) noexcept {
+        self_.promise().set_control(control, index);
+    }
 
-    void set_resume_mux_callback(auto&& cb) {
-        self_.promise().set_resume_mux_callback(cb);
+    // inherited by the adapted task
+    void set_cancellation_token(CancellationToken token) noexcept {
+        self_.promise().set_cancellation_token(token);
     }
 
     void resume() const { return self_.resume(); }
@@ -1,5 +1,13 @@
 #pragma once
 
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "awaiter_concepts.hpp"
+#include "cancellation.hpp"
 #include "mux.hpp"
 
 namespace shcoro {
@@ -13,35 +21,15 @@ struct AllOfAwaiter {
 
     template <typename MuxPromise>
     bool await_suspend(std::coroutine_handle<MuxPromise> mux) {
-        mux.promise().set_resume_limit(sizeof...(T));
-        return std::apply(
-            [&](auto&&... adapters) {
-                auto fn = [&](auto&& adapter) {
-                    adapter.resume();
-                    if (adapter.done()) {
-                        mux.promise().finish_one();
-                        return;
-                    }
-                    adapter.set_resume_mux_callback(
-                        [mux](auto) -> std::coroutine_handle<> {
-                            auto& promise = mux.promise();
-                            SHCORO_LOG("resume allof cb called: ", &promise);
-                            promise.finish_one();
-                            promise.log_progress();
-                            if (!promise.resumable()) {
-                                SHCORO_LOG("allof resume limit not reached");
-                                return std::noop_coroutine();
-                            }
-                            SHCORO_LOG("allof resume limit reached");
-                            return mux;
-                        });
-                };
-
-                (fn(adapters), ...);
-                SHCORO_LOG("allof resumealbe ? ", mux.promise().resumable());
-                return !mux.promise().resumable();
-            },
-            adapters_);
+        CancellationToken token;
+        if constexpr (PromiseCancellationConcept<MuxPromise>) {
+            // the tasks run side by side, none may be abandoned by a race around all_of
+            token = mux.promise().get_cancellation_token().without_abandon();
+        }
+        control_.start(mux, sizeof...(T));
+        start(token, std::index_sequence_for<T...>{});
+        // suspend unless every task finished right away
+        return !control_.started();
     }
 
     auto await_resume() const {
@@ -52,9 +40,25 @@ struct AllOfAwaiter {
     }
 
    protected:
+    template <std::size_t... Is>
+    void start(CancellationToken token, std::index_sequence<Is...>) {
+        auto start_one = [&](auto& adapter, std::size_t index) {
+            adapter.set_cancellation_token(token);
+            adapter.set_control(&control_, index);
+            adapter.resume();
+        };
+        (start_one(std::get<Is>(adapters_), Is), ...);
+    }
+
     std::tuple<MuxAdapter<T>...> adapters_;
+    MuxControl control_;
 };
 
+// The tasks run with a token of the awaiter's own CancellationSource, which is cancelled
+// once the first one finished, or when the any_of itself is cancelled. The other tasks
+// thereby withdraw their pending waits, any_of is resumed once each of them unwound or
+// was abandoned in its next wait (see MuxControl); the adapters destroy the abandoned
+// frames. A task blocked in a wait that can not be cancelled still holds any_of up.
 template <typename... T>
 struct AnyOfAwaiter {
     using return_type = any_of_return_t<T...>;
@@ -66,61 +70,172 @@ struct AnyOfAwaiter {
 
     template <typename MuxPromise>
     bool await_suspend(std::coroutine_handle<MuxPromise> mux) {
-        mux.promise().set_resume_limit(1);
-        return await_suspend_impl(mux, std::index_sequence_for<T...>{});
+        if constexpr (PromiseCancellationConcept<MuxPromise>) {
+            auto token = mux.promise().get_cancellation_token();
+            if (!forward_cb_.arm(token, &forward_cancellation, this)) {
+                cancel_.request_cancellation();
+            }
+        }
+        control_.start_race(mux, sizeof...(T), cancel_);
+        size_t started = start(std::index_sequence_for<T...>{});
+        // suspend unless every started task finished right away
+        return !control_.started(sizeof...(T) - started);
     }
 
-    auto await_resume() {
+    // rethrows the exception of the first task to finish if it failed
+    return_type await_resume() {
         SHCORO_LOG("anyof awaiter resumed");
-        return std::move(ret_);
+        forward_cb_.reset();
+        return result(std::index_sequence_for<T...>{});
     }
 
    protected:
-    template <typename MuxPromise, std::size_t... Is>
-    bool await_suspend_impl(std::coroutine_handle<MuxPromise> mux,
-                            std::index_sequence<Is...>) {
-        // return true to suspend, false to continue immediately
-        return std::apply(
-            [&](auto&&... adapters) {
-                auto try_one = [&](auto I, auto&& adapter) -> bool {
-                    using Adapter = std::decay_t<decltype(adapter)>;
-                    using value_type = replace_void_t<typename Adapter::value_type>;
-
-                    adapter.resume();
-                    if (adapter.done()) {
-                        // Use compile-time index: Is is constexpr
-                        SHCORO_LOG("any of done");
-                        this->ret_ = indexed_type<I, value_type>{adapter.get()};
-                        return true;
-                    }
-
-                    arm_callback<I>(adapter, mux);
-                    return false;
-                };
-
-                // Expand with compile-time indices
-                bool completed =
-                    (try_one(std::integral_constant<std::size_t, Is>{}, adapters) || ...);
-
-                // suspend if not completed immediately
-                return !completed;
-            },
-            adapters_);
+    // stops at the first task that finishes right away, the others never start;
+    // returns the number of started tasks
+    template <std::size_t... Is>
+    size_t start(std::index_sequence<Is...>) {
+        size_t started = 0;
+        auto start_one = [&](auto& adapter, std::size_t index) {
+            adapter.set_cancellation_token(cancel_.token());
+            adapter.set_control(&control_, index);
+            started++;
+            adapter.resume();
+            return control_.done();
+        };
+        (start_one(std::get<Is>(adapters_), Is) || ...);
+        return started;
     }
 
-    template <std::size_t I, class Adapter, class MuxPromise>
-    void arm_callback(Adapter&& adapter, std::coroutine_handle<MuxPromise> mux) {
-        using value_type = replace_void_t<typename std::decay_t<Adapter>::value_type>;
-        adapter.set_resume_mux_callback(
-            [mux, this](auto ret) mutable -> std::coroutine_handle<> {
-                SHCORO_LOG("resume any of cb called");
-                this->ret_ = indexed_type<I, value_type>{std::move(ret)};
-                return mux;
-            });
+    template <std::size_t... Is>
+    return_type result(std::index_sequence<Is...>) {
+        return_type ret;
+        auto take = [&]<std::size_t I>(std::integral_constant<std::size_t, I>) {
+            using Adapter = std::tuple_element_t<I, decltype(adapters_)>;
+            using value_type = replace_void_t<typename Adapter::value_type>;
+            ret = indexed_type<I, value_type>{std::get<I>(adapters_).get()};
+        };
+        ((Is == control_.first() ? take(std::integral_constant<std::size_t, Is>{})
+                                 : void()),
+         ...);
+        return ret;
+    }
+
+    static void forward_cancellation(void* self) {
+        static_cast<AnyOfAwaiter*>(self)->cancel_.request_cancellation();
     }
 
     std::tuple<MuxAdapter<T>...> adapters_;
-    return_type ret_;
+    MuxControl control_;
+    CancellationSource cancel_;
+    CancellationCallback forward_cb_;
+};
+
+// Awaits a number of tasks only known at runtime. There is no Mux coroutine and no
+// adapter per task: the tasks are started directly by the awaiting coroutine and report
+// to the MuxControl of the awaiter from their final suspend, their results are taken
+// from their promises in await_resume. The tasks inherit the scheduler and the
+// cancellation token of the awaiting coroutine, but are never abandoned by its race.
+template <ContinuationAwaiterConcept TaskT>
+class [[nodiscard]] WhenAllAwaiter : noncopyable {
+   public:
+    using value_type = awaiter_return_t<TaskT>;
+
+    explicit WhenAllAwaiter(std::vector<TaskT> tasks) : tasks_(std::move(tasks)) {}
+
+    bool await_ready() const noexcept { return tasks_.empty(); }
+
+    template <typename CallerPromiseType>
+    bool await_suspend(std::coroutine_handle<CallerPromiseType> caller) {
+        control_.start(caller, tasks_.size());
+        for (size_t i = 0; i < tasks_.size(); i++) {
+            auto handle = tasks_[i].await_suspend(caller);
+            auto& promise = handle.promise();
+            auto token = promise.get_cancellation_token();
+            promise.set_cancellation_token(token.without_abandon());
+            promise.set_control(&control_, i);
+            handle.resume();
+        }
+        // suspend unless every task finished right away
+        return !control_.started();
+    }
+
+    // rethrows the exception of the first failed task in order
+    auto await_resume() {
+        SHCORO_LOG("when_all awaiter resumed");
+        if constexpr (std::is_void_v<value_type>) {
+            for (auto& task : tasks_) {
+                task.await_resume();
+            }
+        } else {
+            std::vector<value_type> results;
+            results.reserve(tasks_.size());
+            for (auto& task : tasks_) {
+                results.push_back(task.await_resume());
+            }
+            return results;
+        }
+    }
+
+   private:
+    std::vector<TaskT> tasks_;
+    MuxControl control_;
+};
+
+// Like WhenAllAwaiter, returns the index and the result of the first task to finish.
+// The tasks are cancelled, awaited or abandoned like those of any_of, the ones after a
+// task that finishes right away are never started.
+template <ContinuationAwaiterConcept TaskT>
+class [[nodiscard]] WhenAnyAwaiter : noncopyable {
+   public:
+    using value_type = replace_void_t<awaiter_return_t<TaskT>>;
+    using return_type = std::pair<size_t, value_type>;
+
+    explicit WhenAnyAwaiter(std::vector<TaskT> tasks) : tasks_(std::move(tasks)) {}
+
+    constexpr bool await_ready() const noexcept { return false; }
+
+    template <typename CallerPromiseType>
+    bool await_suspend(std::coroutine_handle<CallerPromiseType> caller) {
+        if constexpr (PromiseCancellationConcept<CallerPromiseType>) {
+            auto token = caller.promise().get_cancellation_token();
+            if (!forward_cb_.arm(token, &forward_cancellation, this)) {
+                cancel_.request_cancellation();
+            }
+        }
+        control_.start_race(caller, tasks_.size(), cancel_);
+        size_t started = 0;
+        for (; started < tasks_.size() && !control_.done(); started++) {
+            tasks_[started].set_cancellation_token(cancel_.token());
+            auto handle = tasks_[started].await_suspend(caller);
+            handle.promise().set_control(&control_, started);
+            handle.resume();
+        }
+        // suspend unless every started task finished right away
+        return !control_.started(tasks_.size() - started);
+    }
+
+    // rethrows the exception of the first task to finish if it failed
+    return_type await_resume() {
+        SHCORO_LOG("when_any awaiter resumed");
+        forward_cb_.reset();
+        size_t index = control_.first();
+        if constexpr (std::is_void_v<awaiter_return_t<TaskT>>) {
+            tasks_[index].await_resume();
+            return {index, value_type{}};
+        } else {
+            return {index, tasks_[index].await_resume()};
+        }
+    }
+
+   private:
+    static void forward_cancellation(void* self) {
+        static_cast<WhenAnyAwaiter*>(self)->cancel_.request_cancellation();
+    }
+
+    std::vector<TaskT> tasks_;
+    MuxControl control_;
+    CancellationSource cancel_;
+    CancellationCallback forward_cb_;
 };
 
-};  // namespace shcoro
\ No newline at end of file
+};  // namespace shcoro
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+
+#include "cancellation.hpp"
+#include "shcoro/utils/logger.h"
+
+namespace shcoro {
+
+// Completion state shared by the tasks of one all_of / any_of / when_all / when_any /
+// with_timeout, embedded in its awaiter. A finished task reports its index through a
+// plain pointer, nothing is allocated or called indirectly; the results stay in the task
+// promises. The awaiting coroutine is resumed once every started task finished.
+// any_of, when_any and with_timeout start a race instead: the first index to finish is
+// kept and that task cancels the others before it counts itself. A loser either unwinds
+// or, once it starts another wait anyway (e.g. a loop ignoring the results), is
+// abandoned: it counts as finished and stays suspended outside of any scheduler until
+// the awaiter destroys it, so no task is destroyed while still linked into a wait.
+// The countdown is atomic so that tasks may finish on different threads, e.g. on the
+// workers of a WorkStealingScheduler; the race's CancellationSource is thread-safe as
+// well. The awaiter holds one extra count while it starts the tasks, so tasks finishing
+// meanwhile do not resume it; started() then tells whether it has to suspend at all.
+class MuxControl {
+   public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    void start(std::coroutine_handle<> mux, size_t count) noexcept {
+        mux_ = mux;
+        race_ = nullptr;
+        first_.store(npos, std::memory_order_relaxed);
+        pending_.store(count + 1, std::memory_order_relaxed);
+    }
+
+    // the tasks are cancelled through race once the first one finished
+    void start_race(std::coroutine_handle<> mux, size_t count,
+                    CancellationSource& race) noexcept {
+        start(mux, count);
+        race_ = &race;
+        race.set_abandon_handler(&abandon, this);
+    }
+
+    // true if the started tasks all finished while starting, the awaiter must not
+    // suspend then; skipped is the number of tasks a race did not start
+    bool started(size_t skipped = 0) noexcept {
+        return pending_.fetch_sub(skipped + 1, std::memory_order_acq_rel) == skipped + 1;
+    }
+
+    // called once by every task at its final suspend, returns what to continue with
+    std::coroutine_handle<> finish(size_t index) noexcept {
+        SHCORO_LOG("mux task finished: ", index);
+        if (race_) {
+            size_t none = npos;
+            if (first_.compare_exchange_strong(none, index, std::memory_order_relaxed)) {
+                // withdrawn waits unwind inline, tasks already resumed elsewhere report
+                // on their own; either way this task still holds its count meanwhile
+                race_->request_cancellation();
+            }
+        }
+        if (pending_.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+            return std::noop_coroutine();
+        }
+        return mux_;
+    }
+
+    // a loser parked in a wait for good, counted like a finished task. Refused while the
+    // race has no winner, the awaiter would have no result to return.
+    static bool abandon(void* self) noexcept {
+        auto& control = *static_cast<MuxControl*>(self);
+        if (!control.done()) {
+            return false;
+        }
+        SHCORO_LOG("mux task abandoned");
+        if (control.pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            control.mux_.resume();
+        }
+        return true;
+    }
+
+    // a race has a winner, the remaining tasks need not be started
+    bool done() const noexcept { return first() != npos; }
+    size_t first() const noexcept { return first_.load(std::memory_order_relaxed); }
+
+   private:
+    std::coroutine_handle<> mux_{nullptr};
+    CancellationSource* race_{nullptr};
+    std::atomic<size_t> first_{npos};
+    std::atomic<size_t> pending_{0};
+};
+
+}  // namespace shcoro
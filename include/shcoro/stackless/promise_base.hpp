@@ -1,34 +1,91 @@
 #pragma once
 
 #include <coroutine>
+#include <exception>
 #include <stdexcept>
 #include <tuple>
 #include <vector>
 
+#include "cancellation.hpp"
+#include "frame_allocator.hpp"
+#include "mux_control.hpp"
 #include "scheduler.hpp"
+#include "shcoro/utils/exception.h"
 
 namespace shcoro {
 
-// exception handling
+// exception handling: an exception escaping the coroutine body is kept in the promise
+// and rethrown by whoever consumes the result
+#if SHCORO_EXCEPTIONS
 struct promise_exception_base {
-    void unhandled_exception() { std::terminate(); }
+    void unhandled_exception() noexcept { exception_ = std::current_exception(); }
+
+    bool has_exception() const noexcept { return exception_ != nullptr; }
+    std::exception_ptr get_exception() const noexcept { return exception_; }
+
+    void rethrow_if_exception() const {
+        if (exception_) [[unlikely]] {
+            std::rethrow_exception(exception_);
+        }
+    }
+
+   protected:
+    std::exception_ptr exception_{nullptr};
+};
+#else
+// nothing can escape a coroutine body, errors travel in the return value
+struct promise_exception_base {
+    void unhandled_exception() noexcept { std::terminate(); }
+
+    constexpr bool has_exception() const noexcept { return false; }
+    constexpr void rethrow_if_exception() const noexcept {}
+};
+#endif
+
+// for coroutines nobody waits on
+struct promise_terminate_base {
+    void unhandled_exception() noexcept { std::terminate(); }
 };
 
 // scheduler support
 struct promise_scheduler_base {
     void set_scheduler(Scheduler other) noexcept { scheduler_ = std::move(other); }
     Scheduler& get_scheduler() noexcept { return scheduler_; }
+    SchedulerNode& get_scheduler_node() noexcept { return scheduler_node_; }
 
    protected:
     Scheduler scheduler_;
+    SchedulerNode scheduler_node_;
+};
+
+// cancellation support, the token flows from the caller like the scheduler
+struct promise_cancellation_base {
+    void set_cancellation_token(CancellationToken token) noexcept { token_ = token; }
+    CancellationToken get_cancellation_token() const noexcept { return token_; }
+
+   protected:
+    CancellationToken token_;
 };
 
 struct promise_caller_base {
     void set_caller(std::coroutine_handle<> handle) noexcept { caller_ = handle; }
     std::coroutine_handle<> get_caller() noexcept { return caller_; }
 
+    // when_all / when_any: index is reported to control instead of resuming the caller
+    void set_control(MuxControl* control, size_t index) noexcept {
+        control_ = control;
+        index_ = index;
+    }
+
+    // what to continue with at the final suspend
+    std::coroutine_handle<> continuation() noexcept {
+        return control_ ? control_->finish(index_) : caller_;
+    }
+
    protected:
     std::coroutine_handle<> caller_;
+    MuxControl* control_{nullptr};
+    size_t index_{0};
 };
 
 struct promise_callee_base {
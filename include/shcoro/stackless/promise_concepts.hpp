@@ -2,6 +2,7 @@
 
 #include <concepts>
 
+#include "cancellation.hpp"
 #include "scheduler.hpp"
 
 namespace shcoro {
@@ -16,4 +17,18 @@ concept PromiseSchedulerConcept = requires(Promise p, Scheduler sched) {
     p.set_scheduler(sched);
 };
 
+// Promise that embeds an intrusive SchedulerNode
+template <typename Promise>
+concept PromiseSchedulerNodeConcept =
+    PromiseSchedulerConcept<Promise> && requires(Promise p) {
+        { p.get_scheduler_node() } -> std::same_as<SchedulerNode&>;
+    };
+
+// Promise that carries the CancellationToken of its operation
+template <typename Promise>
+concept PromiseCancellationConcept = requires(Promise p, CancellationToken token) {
+    { p.get_cancellation_token() } -> std::same_as<CancellationToken>;
+    p.set_cancellation_token(token);
+};
+
 }  // namespace shcoro
\ No newline at end of file
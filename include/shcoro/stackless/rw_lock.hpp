@@ -3,48 +3,76 @@
 #include <stdint.h>
 
 #include <coroutine>
-#include <queue>
+#include <utility>
 
 #include "shcoro/utils/noncopyable.h"
+#include "waiter.hpp"
 
 namespace shcoro {
 
-enum class RWLockPolicy { READ_RPIOR, FAIR };
+// READ_RPIOR: readers get in whenever no writer holds the lock
+// WRITE_PRIOR: readers wait while a writer holds the lock or is waiting for it
+// FAIR: waiters are served in arrival order, consecutive readers together
+enum class RWLockPolicy { READ_RPIOR, WRITE_PRIOR, FAIR };
 
+// Waiter embedded in ReadAwaiter / WriteAwaiter
+struct RWLockWaiter : Waiter {
+    RWLockWaiter* next_{nullptr};
+    bool is_writer_{false};
+};
+
+// Ownership is accounted for when a waiter is handed the lock, so a waiter that is
+// rescheduled (WakeupPolicy::RESCHEDULE) instead of resumed inline still holds it.
+// Readers and writers wait in separate queues. When the lock is released, READ_RPIOR
+// hands it to every waiting reader at once and to a writer only if no reader waits,
+// WRITE_PRIOR to the next writer and to every waiting reader only if no writer waits.
 template <RWLockPolicy Policy = RWLockPolicy::READ_RPIOR>
 class RWLock final : noncopyable {
    public:
-    struct ReadAwaiter {
+    struct ReadAwaiter : RWLockWaiter {
         ReadAwaiter(RWLock* lock) : lock_(lock) {}
 
-        bool await_ready() noexcept { return !lock_->writer_active_; }
+        bool await_ready() noexcept { return lock_->try_read_lock(); }
 
-        void await_suspend(std::coroutine_handle<> caller) {
-            lock_->waiting_list_.push(caller);
+        template <typename CallerPromiseType>
+        bool await_suspend(std::coroutine_handle<CallerPromiseType> caller) noexcept {
+            set_waiter(caller);
+            if (!watch_cancellation(&RWLock::on_cancel, static_cast<RWLockWaiter*>(this))) {
+                return yield_cancelled();
+            }
+            lock_->read_waiters_.push(*this);
+            return true;
         }
 
-        void await_resume() noexcept { lock_->active_readers_++; }
+        // false if the wait was cancelled and the lock is not held
+        [[nodiscard]] bool await_resume() noexcept { return !cancelled_; }
 
         RWLock* lock_{nullptr};
     };
 
-    struct WriteAwaiter {
-        WriteAwaiter(RWLock* lock) : lock_(lock) {}
+    struct WriteAwaiter : RWLockWaiter {
+        WriteAwaiter(RWLock* lock) : lock_(lock) { is_writer_ = true; }
 
-        bool await_ready() noexcept {
-            return (lock_->active_readers_ == 0 && !lock_->writer_active_);
-        }
+        bool await_ready() noexcept { return lock_->try_write_lock(); }
 
-        void await_suspend(std::coroutine_handle<> caller) {
-            lock_->waiting_list_.push(caller);
+        template <typename CallerPromiseType>
+        bool await_suspend(std::coroutine_handle<CallerPromiseType> caller) noexcept {
+            set_waiter(caller);
+            if (!watch_cancellation(&RWLock::on_cancel, static_cast<RWLockWaiter*>(this))) {
+                return yield_cancelled();
+            }
+            lock_->write_waiters_.push(*this);
+            return true;
         }
 
-        void await_resume() noexcept { lock_->writer_active_ = true; }
+        // false if the wait was cancelled and the lock is not held
+        [[nodiscard]] bool await_resume() noexcept { return !cancelled_; }
 
         RWLock* lock_{nullptr};
     };
 
-    RWLock() = default;
+    explicit RWLock(WakeupPolicy policy = WakeupPolicy::INLINE) noexcept
+        : policy_(policy) {}
     RWLock(RWLock&& other) noexcept = default;
     ~RWLock() = default;
 
@@ -52,6 +80,11 @@ class RWLock final : noncopyable {
         if (writer_active_) {
             return false;
         }
+        if constexpr (Policy == RWLockPolicy::WRITE_PRIOR) {
+            if (!write_waiters_.empty()) {
+                return false;
+            }
+        }
         active_readers_++;
         return true;
     }
@@ -68,67 +101,133 @@ class RWLock final : noncopyable {
 
     void read_unlock() {
         if (--active_readers_ != 0) return;
-        if (!waiting_list_.empty()) {
-            auto nxt = waiting_list_.front();
-            waiting_list_.pop();
-            nxt.resume();
-        }
+        hand_over();
     }
     void write_unlock() {
         writer_active_ = false;
-        if (!waiting_list_.empty()) {
-            auto nxt = waiting_list_.front();
-            waiting_list_.pop();
-            nxt.resume();
+        hand_over();
+    }
+
+    // co_await lock.scoped_*_lock() returns a guard that unlocks on destruction, an empty
+    // one if the wait was cancelled
+    using ScopedReadLock = ScopedLockGuard<RWLock, &RWLock::read_unlock>;
+    using ScopedWriteLock = ScopedLockGuard<RWLock, &RWLock::write_unlock>;
+
+    struct ScopedReadAwaiter : ReadAwaiter {
+        using ReadAwaiter::ReadAwaiter;
+        ScopedReadLock await_resume() noexcept {
+            return this->cancelled_ ? ScopedReadLock() : ScopedReadLock(*this->lock_);
+        }
+    };
+
+    struct ScopedWriteAwaiter : WriteAwaiter {
+        using WriteAwaiter::WriteAwaiter;
+        ScopedWriteLock await_resume() noexcept {
+            return this->cancelled_ ? ScopedWriteLock() : ScopedWriteLock(*this->lock_);
         }
+    };
+
+    [[nodiscard]] ScopedReadAwaiter scoped_read_lock() { return ScopedReadAwaiter(this); }
+    [[nodiscard]] ScopedWriteAwaiter scoped_write_lock() {
+        return ScopedWriteAwaiter(this);
     }
 
    private:
-    std::queue<std::coroutine_handle<>> waiting_list_;
+    void hand_over() {
+        bool to_readers = Policy == RWLockPolicy::WRITE_PRIOR ? write_waiters_.empty()
+                                                              : !read_waiters_.empty();
+        if (to_readers) {
+            hand_over_to_readers();
+        } else if (!write_waiters_.empty()) {
+            writer_active_ = true;
+            // the awaiter lives in the waiter frame, it is gone once woken
+            write_waiters_.pop().wake(policy_);
+        }
+    }
+
+    // a cancelled writer may have been the only thing holding WRITE_PRIOR readers back
+    static void on_cancel(void* self) {
+        auto& waiter = *static_cast<RWLockWaiter*>(self);
+        auto* lock = waiter.is_writer_ ? static_cast<WriteAwaiter&>(waiter).lock_
+                                       : static_cast<ReadAwaiter&>(waiter).lock_;
+        auto& queue = waiter.is_writer_ ? lock->write_waiters_ : lock->read_waiters_;
+        if (!queue.remove(waiter)) {
+            return;
+        }
+        if (Policy == RWLockPolicy::WRITE_PRIOR && !lock->writer_active_ &&
+            lock->write_waiters_.empty()) {
+            lock->hand_over_to_readers();
+        }
+        waiter.cancel();
+    }
+
+    // all waiting readers are counted first, then woken in one pass
+    void hand_over_to_readers() {
+        auto readers = std::exchange(read_waiters_, {});
+        for (auto* reader = readers.head(); reader; reader = reader->next_) {
+            active_readers_++;
+        }
+        while (!readers.empty()) {
+            readers.pop().wake(policy_);
+        }
+    }
+
+    WaiterQueue<RWLockWaiter> read_waiters_;
+    WaiterQueue<RWLockWaiter> write_waiters_;
     size_t active_readers_{0};
     bool writer_active_{false};
+    WakeupPolicy policy_;
 };
 
 template <>
 class RWLock<RWLockPolicy::FAIR> final : noncopyable {
    public:
-    struct ReadAwaiter {
+    struct ReadAwaiter : RWLockWaiter {
         ReadAwaiter(RWLock* lock) : lock_(lock) {}
 
-        bool await_ready() noexcept {
-            return (!lock_->writer_active_ && !lock_->waiting_writer_);
-        }
+        bool await_ready() noexcept { return lock_->try_read_lock(); }
 
-        void await_suspend(std::coroutine_handle<> caller) {
-            lock_->waiting_list_.push(CoroNode{.handle_ = caller, .is_writer_ = false});
+        template <typename CallerPromiseType>
+        bool await_suspend(std::coroutine_handle<CallerPromiseType> caller) noexcept {
+            set_waiter(caller);
+            if (!watch_cancellation(&RWLock::on_cancel, static_cast<RWLockWaiter*>(this))) {
+                return yield_cancelled();
+            }
+            lock_->waiting_list_.push(*this);
+            return true;
         }
 
-        void await_resume() noexcept { lock_->active_readers_++; }
+        // false if the wait was cancelled and the lock is not held
+        [[nodiscard]] bool await_resume() noexcept { return !cancelled_; }
 
         RWLock* lock_{nullptr};
     };
 
-    struct WriteAwaiter {
-        WriteAwaiter(RWLock* lock) : lock_(lock) {}
+    struct WriteAwaiter : RWLockWaiter {
+        WriteAwaiter(RWLock* lock) : lock_(lock) { is_writer_ = true; }
 
-        bool await_ready() noexcept {
-            lock_->waiting_writer_++;
-            return (!lock_->active_readers_ && !lock_->writer_active_);
-        }
+        bool await_ready() noexcept { return lock_->try_write_lock(); }
 
-        void await_suspend(std::coroutine_handle<> caller) {
-            lock_->waiting_list_.push(CoroNode{.handle_ = caller, .is_writer_ = true});
+        template <typename CallerPromiseType>
+        bool await_suspend(std::coroutine_handle<CallerPromiseType> caller) noexcept {
+            set_waiter(caller);
+            if (!watch_cancellation(&RWLock::on_cancel, static_cast<RWLockWaiter*>(this))) {
+                return yield_cancelled();
+            }
+            // readers arriving from now on queue up behind this writer
+            lock_->waiting_writer_++;
+            lock_->waiting_list_.push(*this);
+            return true;
         }
 
-        void await_resume() noexcept {
-            lock_->waiting_writer_--;
-            lock_->writer_active_ = true;
-        }
+        // false if the wait was cancelled and the lock is not held
+        [[nodiscard]] bool await_resume() noexcept { return !cancelled_; }
 
         RWLock* lock_{nullptr};
     };
 
-    RWLock() = default;
+    explicit RWLock(WakeupPolicy policy = WakeupPolicy::INLINE) noexcept
+        : policy_(policy) {}
     RWLock(RWLock&& other) noexcept = default;
     ~RWLock() = default;
 
@@ -152,39 +251,89 @@ class RWLock<RWLockPolicy::FAIR> final : noncopyable {
 
     void read_unlock() {
         if (--active_readers_ != 0) return;
-        if (!waiting_list_.empty()) {
-            auto nxt = waiting_list_.front().handle_;
-            waiting_list_.pop();
-            nxt.resume();
-        }
+        hand_over();
     }
     void write_unlock() {
         writer_active_ = false;
+        hand_over();
+    }
+
+    // co_await lock.scoped_*_lock() returns a guard that unlocks on destruction, an empty
+    // one if the wait was cancelled
+    using ScopedReadLock = ScopedLockGuard<RWLock, &RWLock::read_unlock>;
+    using ScopedWriteLock = ScopedLockGuard<RWLock, &RWLock::write_unlock>;
 
+    struct ScopedReadAwaiter : ReadAwaiter {
+        using ReadAwaiter::ReadAwaiter;
+        ScopedReadLock await_resume() noexcept {
+            return cancelled_ ? ScopedReadLock() : ScopedReadLock(*lock_);
+        }
+    };
+
+    struct ScopedWriteAwaiter : WriteAwaiter {
+        using WriteAwaiter::WriteAwaiter;
+        ScopedWriteLock await_resume() noexcept {
+            return cancelled_ ? ScopedWriteLock() : ScopedWriteLock(*lock_);
+        }
+    };
+
+    [[nodiscard]] ScopedReadAwaiter scoped_read_lock() { return ScopedReadAwaiter(this); }
+    [[nodiscard]] ScopedWriteAwaiter scoped_write_lock() {
+        return ScopedWriteAwaiter(this);
+    }
+
+   private:
+    void hand_over() {
         if (waiting_list_.empty()) return;
 
-        auto nxt = waiting_list_.front();
-        waiting_list_.pop();
-        nxt.handle_.resume();
-        if (nxt.is_writer_) return;
+        auto& first = waiting_list_.pop();
+        if (first.is_writer_) {
+            waiting_writer_--;
+            writer_active_ = true;
+            first.wake(policy_);
+            return;
+        }
+
+        // grouped readers are all counted before any of them runs
+        WaiterQueue<RWLockWaiter> readers;
+        readers.push(first);
+        active_readers_++;
+        hand_over_to_readers(readers);
+    }
 
-        // resume grouped readers
+    // the readers at the front of the queue join the ones in readers
+    void hand_over_to_readers(WaiterQueue<RWLockWaiter>& readers) {
         while (!waiting_list_.empty() && !waiting_list_.front().is_writer_) {
-            auto nxt = waiting_list_.front().handle_;
-            waiting_list_.pop();
-            nxt.resume();
+            readers.push(waiting_list_.pop());
+            active_readers_++;
+        }
+        while (!readers.empty()) {
+            readers.pop().wake(policy_);
         }
     }
 
-   private:
-    struct CoroNode {
-        std::coroutine_handle<> handle_;
-        bool is_writer_;
-    };
+    // readers queued behind a cancelled writer join the readers holding the lock
+    static void on_cancel(void* self) {
+        auto& waiter = *static_cast<RWLockWaiter*>(self);
+        auto* lock = waiter.is_writer_ ? static_cast<WriteAwaiter&>(waiter).lock_
+                                       : static_cast<ReadAwaiter&>(waiter).lock_;
+        if (!lock->waiting_list_.remove(waiter)) {
+            return;
+        }
+        if (waiter.is_writer_) {
+            lock->waiting_writer_--;
+            if (lock->active_readers_ != 0) {
+                WaiterQueue<RWLockWaiter> readers;
+                lock->hand_over_to_readers(readers);
+            }
+        }
+        waiter.cancel();
+    }
 
-    std::queue<CoroNode> waiting_list_;
+    WaiterQueue<RWLockWaiter> waiting_list_;
     size_t active_readers_{0};
     size_t waiting_writer_{0};
     bool writer_active_{false};
+    WakeupPolicy policy_;
 };
-}  // namespace shcoro
\ No newline at end of file
+}  // namespace shcoro
@@ -1,12 +1,15 @@
 #pragma once
 
-#include <any>
 #include <concepts>
 #include <coroutine>
+#include <exception>
 #include <memory>
+#include <tuple>
 #include <type_traits>
 #include <utility>
 
+#include "scheduler_node.hpp"
+
 namespace shcoro {
 
 template <class SchedulerT>
@@ -32,12 +35,84 @@ concept SchedulerWithValue = requires(SchedulerT& sched, std::coroutine_handle<>
     sched.unregister_coro(h);
 };
 
+// A no-value scheduler that can also queue the SchedulerNode stored in the promise
+template <class SchedulerT>
+concept SchedulerIntrusive = SchedulerNoValue<SchedulerT> &&
+                             requires(SchedulerT& sched, SchedulerNode& node) {
+                                 sched.register_node(node);
+                                 sched.unregister_node(node);
+                             };
+
+// A value scheduler that can also queue the SchedulerNode stored in the promise
+template <class SchedulerT>
+concept SchedulerIntrusiveWithValue =
+    SchedulerWithValue<SchedulerT> &&
+    requires(SchedulerT& sched, SchedulerNode& node,
+             const typename SchedulerT::value_type& cv) {
+        sched.register_node(node, cv);
+        sched.unregister_node(node);
+    };
+
+namespace detail {
+template <class SchedulerT, class ValueT>
+concept accepts_value = requires(SchedulerT& sched, std::coroutine_handle<> h,
+                                 const ValueT& cv) { sched.register_coro(h, cv); };
+
+template <class SchedulerT, class ValueTuple>
+struct accepts_values : std::false_type {};
+
+template <class SchedulerT, class... ValueTs>
+struct accepts_values<SchedulerT, std::tuple<ValueTs...>>
+    : std::bool_constant<(accepts_value<SchedulerT, ValueTs> && ...)> {};
+
+// unique address per value type, used to route a type-erased value
+template <class ValueT>
+struct value_type_tag {
+    static constexpr char id = 0;
+};
+
+template <class ValueT>
+constexpr const void* value_type_id() noexcept {
+    return &value_type_tag<std::remove_cvref_t<ValueT>>::id;
+}
+}  // namespace detail
+
+// A scheduler accepting several value types, listed in a std::tuple. A registration is
+// routed to the register_coro overload of the awaiter's value type, registrations
+// without a value go to register_coro(h) or register_node(node).
+template <class SchedulerT>
+concept SchedulerMultiValue =
+    SchedulerNoValue<SchedulerT> && requires { typename SchedulerT::value_types; } &&
+    detail::accepts_values<SchedulerT, typename SchedulerT::value_types>::value;
+
 template <class SchedulerT>
 concept SchedulerConcept = SchedulerNoValue<SchedulerT> || SchedulerWithValue<SchedulerT>;
 
+// A scheduler whose unregister_coro (and unregister_node if intrusive) return true when
+// they took back a pending registration: the scheduler will not resume the coroutine,
+// so whoever unregistered it may. Cancelled waits rely on it, see CancellableWait.
+template <class SchedulerT>
+concept SchedulerWithdraw =
+    requires(SchedulerT& sched, std::coroutine_handle<> h) {
+        { sched.unregister_coro(h) } -> std::same_as<bool>;
+    } && (!requires(SchedulerT& sched, SchedulerNode& node) {
+        sched.unregister_node(node);
+    } || requires(SchedulerT& sched, SchedulerNode& node) {
+        { sched.unregister_node(node) } -> std::same_as<bool>;
+    });
+
+// A scheduler that can end a pending wait early with cancel_coro, it still resumes the
+// coroutine itself once the wait has ended, e.g. after the kernel confirmed an IO cancel.
+template <class SchedulerT>
+concept SchedulerCancel = requires(SchedulerT& sched, std::coroutine_handle<> h) {
+    sched.cancel_coro(h);
+};
+
+// Non-owning, type-erased reference to a scheduler: a pointer to the scheduler
+// plus a pointer to a static function table, so copies are trivial.
 class Scheduler {
    private:
-    struct SchedulerBase;
+    struct SchedulerVTable;
 
     template <SchedulerNoValue SchedulerT>
     struct NonOwningSchedulerModelNoValue;
@@ -45,40 +120,34 @@ class Scheduler {
     template <SchedulerWithValue SchedulerT>
     struct NonOwningSchedulerModelWithValue;
 
+    template <SchedulerMultiValue SchedulerT>
+    struct NonOwningSchedulerModelMultiValue;
+
    public:
     Scheduler() = default;
 
     template <SchedulerConcept SchedulerT>
-    Scheduler(SchedulerT& sched)
-        : pimpl_([&]() -> std::unique_ptr<SchedulerBase> {
-              if constexpr (SchedulerWithValue<SchedulerT>) {
-                  return std::make_unique<NonOwningSchedulerModelWithValue<SchedulerT>>(
-                      sched);
-              } else {
-                  return std::make_unique<NonOwningSchedulerModelNoValue<SchedulerT>>(
-                      sched);
-              }
-          }()) {}
-
-    Scheduler(const Scheduler& other)
-        : pimpl_(other.pimpl_ ? other.pimpl_->clone() : nullptr) {}
-    Scheduler& operator=(const Scheduler& other) {
-        Scheduler copy(other);
-        pimpl_.swap(copy.pimpl_);
-        return *this;
+    Scheduler(SchedulerT& sched) noexcept : sched_(std::addressof(sched)) {
+        if constexpr (SchedulerMultiValue<SchedulerT>) {
+            vtable_ = &NonOwningSchedulerModelMultiValue<SchedulerT>::vtable;
+        } else if constexpr (SchedulerWithValue<SchedulerT>) {
+            vtable_ = &NonOwningSchedulerModelWithValue<SchedulerT>::vtable;
+        } else {
+            vtable_ = &NonOwningSchedulerModelNoValue<SchedulerT>::vtable;
+        }
     }
 
-    ~Scheduler() = default;
-    Scheduler(Scheduler&&) noexcept = default;
-    Scheduler& operator=(Scheduler&&) noexcept = default;
+    operator bool() const noexcept { return sched_ != nullptr; }
 
-    operator bool() const noexcept { return pimpl_ != nullptr; }
+    friend bool operator==(const Scheduler& lhs, const Scheduler& rhs) noexcept {
+        return lhs.sched_ == rhs.sched_;
+    }
 
     friend void scheduler_register_coro(Scheduler& sched, std::coroutine_handle<> h) {
         if (!sched) [[unlikely]] {
             std::terminate();
         }
-        sched.pimpl_->register_coro(h);
+        sched.vtable_->register_coro(sched.sched_, h);
     }
 
     template <class ValueT>
@@ -87,69 +156,235 @@ class Scheduler {
         if (!sched) [[unlikely]] {
             std::terminate();
         }
-        sched.pimpl_->register_coro(h, &v);
+        sched.vtable_->register_coro_with_value(sched.sched_, h, &v,
+                                                detail::value_type_id<ValueT>());
+    }
+
+    // true if the registration was withdrawn, always false unless can_withdraw()
+    friend bool scheduler_unregister_coro(Scheduler& sched, std::coroutine_handle<> h) {
+        if (!sched) [[unlikely]] {
+            std::terminate();
+        }
+        return sched.vtable_->unregister_coro(sched.sched_, h);
     }
 
-    friend void scheduler_unregister_coro(Scheduler& sched, std::coroutine_handle<> h) {
+    // node.handle_ must be set, schedulers that are not intrusive fall back to it
+    friend void scheduler_register_node(Scheduler& sched, SchedulerNode& node) {
         if (!sched) [[unlikely]] {
             std::terminate();
         }
-        sched.pimpl_->unregister_coro(h);
+        sched.vtable_->register_node(sched.sched_, node);
     }
 
+    template <class ValueT>
+    friend void scheduler_register_node(Scheduler& sched, SchedulerNode& node, ValueT&& v) {
+        if (!sched) [[unlikely]] {
+            std::terminate();
+        }
+        sched.vtable_->register_node_with_value(sched.sched_, node, &v,
+                                                detail::value_type_id<ValueT>());
+    }
+
+    friend bool scheduler_unregister_node(Scheduler& sched, SchedulerNode& node) {
+        if (!sched) [[unlikely]] {
+            std::terminate();
+        }
+        return sched.vtable_->unregister_node(sched.sched_, node);
+    }
+
+    // only if can_cancel(), the scheduler resumes h once the wait has ended
+    friend void scheduler_cancel_coro(Scheduler& sched, std::coroutine_handle<> h) {
+        if (!sched || !sched.can_cancel()) [[unlikely]] {
+            std::terminate();
+        }
+        sched.vtable_->cancel_coro(sched.sched_, h);
+    }
+
+    // see SchedulerWithdraw and SchedulerCancel
+    bool can_withdraw() const noexcept { return sched_ && vtable_->can_withdraw; }
+    bool can_cancel() const noexcept { return sched_ && vtable_->cancel_coro; }
+    // takes registrations without a value, i.e. a coroutine can give up the thread
+    bool can_yield() const noexcept { return sched_ && vtable_->can_yield; }
+
    private:
-    struct SchedulerBase {
-        virtual ~SchedulerBase() = default;
-        virtual void register_coro(std::coroutine_handle<>) = 0;
-        virtual void register_coro(std::coroutine_handle<>, const void*) = 0;
-        virtual void unregister_coro(std::coroutine_handle<>) = 0;
-        virtual std::unique_ptr<SchedulerBase> clone() const = 0;
+    struct SchedulerVTable {
+        void (*register_coro)(void*, std::coroutine_handle<>);
+        // the last argument is detail::value_type_id of the value
+        void (*register_coro_with_value)(void*, std::coroutine_handle<>, const void*,
+                                         const void*);
+        bool (*unregister_coro)(void*, std::coroutine_handle<>);
+        void (*register_node)(void*, SchedulerNode&);
+        void (*register_node_with_value)(void*, SchedulerNode&, const void*, const void*);
+        bool (*unregister_node)(void*, SchedulerNode&);
+        void (*cancel_coro)(void*, std::coroutine_handle<>);  // nullptr if not supported
+        bool can_withdraw;
+        bool can_yield;
     };
 
+    // the unregister result, false for schedulers that can not withdraw
+    template <class Fn>
+    static bool withdrawn(Fn&& unregister) {
+        if constexpr (std::is_same_v<decltype(unregister()), bool>) {
+            return unregister();
+        } else {
+            unregister();
+            return false;
+        }
+    }
+
+    template <class SchedulerT>
+    static constexpr auto cancel_coro_of() noexcept {
+        void (*cancel)(void*, std::coroutine_handle<>) = nullptr;
+        if constexpr (SchedulerCancel<SchedulerT>) {
+            cancel = [](void* sched, std::coroutine_handle<> h) {
+                static_cast<SchedulerT*>(sched)->cancel_coro(h);
+            };
+        }
+        return cancel;
+    }
+
     template <SchedulerNoValue SchedulerT>
-    struct NonOwningSchedulerModelNoValue final : SchedulerBase {
-        explicit NonOwningSchedulerModelNoValue(SchedulerT& s) : sched_(&s) {}
+    struct NonOwningSchedulerModelNoValue {
+        static SchedulerT* get(void* sched) noexcept {
+            return static_cast<SchedulerT*>(sched);
+        }
 
-        void register_coro(std::coroutine_handle<> h) override {
-            sched_->register_coro(h);
+        static void register_coro(void* sched, std::coroutine_handle<> h) {
+            get(sched)->register_coro(h);
         }
 
-        void register_coro(std::coroutine_handle<> h, const void*) override {}
+        static void register_coro_with_value(void*, std::coroutine_handle<>, const void*,
+                                             const void*) {}
 
-        void unregister_coro(std::coroutine_handle<> h) override {
-            sched_->unregister_coro(h);
+        static bool unregister_coro(void* sched, std::coroutine_handle<> h) {
+            return withdrawn([&] { return get(sched)->unregister_coro(h); });
         }
 
-        std::unique_ptr<SchedulerBase> clone() const override {
-            return std::make_unique<NonOwningSchedulerModelNoValue>(*this);
+        static void register_node(void* sched, SchedulerNode& node) {
+            if constexpr (SchedulerIntrusive<SchedulerT>) {
+                get(sched)->register_node(node);
+            } else {
+                get(sched)->register_coro(node.handle_);
+            }
         }
 
-        SchedulerT* sched_{nullptr};
+        static void register_node_with_value(void*, SchedulerNode&, const void*,
+                                             const void*) {}
+
+        static bool unregister_node(void* sched, SchedulerNode& node) {
+            if constexpr (SchedulerIntrusive<SchedulerT>) {
+                return withdrawn([&] { return get(sched)->unregister_node(node); });
+            } else {
+                return unregister_coro(sched, node.handle_);
+            }
+        }
+
+        static constexpr SchedulerVTable vtable{
+            &register_coro, &register_coro_with_value, &unregister_coro,
+            &register_node, &register_node_with_value, &unregister_node,
+            cancel_coro_of<SchedulerT>(), SchedulerWithdraw<SchedulerT>, true,
+        };
     };
 
     template <SchedulerWithValue SchedulerT>
-    struct NonOwningSchedulerModelWithValue final : SchedulerBase {
-        explicit NonOwningSchedulerModelWithValue(SchedulerT& s) : sched_(&s) {}
+    struct NonOwningSchedulerModelWithValue {
+        static SchedulerT* get(void* sched) noexcept {
+            return static_cast<SchedulerT*>(sched);
+        }
+
+        static void register_coro(void*, std::coroutine_handle<>) {}
+
+        static void register_coro_with_value(void* sched, std::coroutine_handle<> h,
+                                             const void* value, const void* type) {
+            using ValueT = typename SchedulerT::value_type;
+            if (type != detail::value_type_id<ValueT>()) [[unlikely]] {
+                // awaiter value does not match the scheduler
+                std::terminate();
+            }
+            get(sched)->register_coro(h, *static_cast<const ValueT*>(value));
+        }
+
+        static bool unregister_coro(void* sched, std::coroutine_handle<> h) {
+            return withdrawn([&] { return get(sched)->unregister_coro(h); });
+        }
 
-        void register_coro(std::coroutine_handle<> h) override {}
+        static void register_node(void*, SchedulerNode&) {}
 
-        void register_coro(std::coroutine_handle<> h, const void* value) override {
+        static void register_node_with_value(void* sched, SchedulerNode& node,
+                                             const void* value, const void* type) {
             using ValueT = typename SchedulerT::value_type;
-            sched_->register_coro(h, *static_cast<const ValueT*>(value));
+            if (type != detail::value_type_id<ValueT>()) [[unlikely]] {
+                std::terminate();
+            }
+            if constexpr (SchedulerIntrusiveWithValue<SchedulerT>) {
+                get(sched)->register_node(node, *static_cast<const ValueT*>(value));
+            } else {
+                get(sched)->register_coro(node.handle_, *static_cast<const ValueT*>(value));
+            }
         }
 
-        void unregister_coro(std::coroutine_handle<> h) override {
-            sched_->unregister_coro(h);
+        static bool unregister_node(void* sched, SchedulerNode& node) {
+            if constexpr (SchedulerIntrusiveWithValue<SchedulerT>) {
+                return withdrawn([&] { return get(sched)->unregister_node(node); });
+            } else {
+                return unregister_coro(sched, node.handle_);
+            }
         }
 
-        std::unique_ptr<SchedulerBase> clone() const override {
-            return std::make_unique<NonOwningSchedulerModelWithValue>(*this);
+        static constexpr SchedulerVTable vtable{
+            &register_coro, &register_coro_with_value, &unregister_coro,
+            &register_node, &register_node_with_value, &unregister_node,
+            cancel_coro_of<SchedulerT>(), SchedulerWithdraw<SchedulerT>, false,
+        };
+    };
+
+    template <SchedulerMultiValue SchedulerT>
+    struct NonOwningSchedulerModelMultiValue : NonOwningSchedulerModelNoValue<SchedulerT> {
+        using Base = NonOwningSchedulerModelNoValue<SchedulerT>;
+        using ValueTypes = typename SchedulerT::value_types;
+
+        static void register_coro_with_value(void* sched, std::coroutine_handle<> h,
+                                             const void* value, const void* type) {
+            route(type, value,
+                  [&](const auto& v) { Base::get(sched)->register_coro(h, v); });
+        }
+
+        static void register_node_with_value(void* sched, SchedulerNode& node,
+                                             const void* value, const void* type) {
+            route(type, value, [&](const auto& v) {
+                if constexpr (requires { Base::get(sched)->register_node(node, v); }) {
+                    Base::get(sched)->register_node(node, v);
+                } else {
+                    Base::get(sched)->register_coro(node.handle_, v);
+                }
+            });
+        }
+
+        template <class Fn>
+        static void route(const void* type, const void* value, Fn&& fn) {
+            auto try_each = [&]<class... Ts>(std::type_identity<std::tuple<Ts...>>) {
+                return ((type == detail::value_type_id<Ts>()
+                             ? (fn(*static_cast<const Ts*>(value)), true)
+                             : false) ||
+                        ...);
+            };
+            if (!try_each(std::type_identity<ValueTypes>{})) [[unlikely]] {
+                // no value type of the scheduler matches the awaiter
+                std::terminate();
+            }
         }
 
-        SchedulerT* sched_{nullptr};
+        static constexpr SchedulerVTable vtable{
+            &Base::register_coro, &register_coro_with_value, &Base::unregister_coro,
+            &Base::register_node, &register_node_with_value, &Base::unregister_node,
+            cancel_coro_of<SchedulerT>(), SchedulerWithdraw<SchedulerT>, true,
+        };
     };
 
-    std::unique_ptr<SchedulerBase> pimpl_{};
+    void* sched_{nullptr};
+    const SchedulerVTable* vtable_{nullptr};
 };
 
+static_assert(std::is_trivially_copyable_v<Scheduler>);
+
 }  // namespace shcoro
\ No newline at end of file
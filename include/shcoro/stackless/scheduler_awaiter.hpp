@@ -1,37 +1,172 @@
 #pragma once
 
+#include <chrono>
 #include <coroutine>
+#include <type_traits>
 
+#include "cancellation.hpp"
 #include "promise_concepts.hpp"
 
 namespace shcoro {
 
+// Lets the caller's cancellation token interrupt a wait registered on a scheduler. The
+// callback is armed before registering, and only on schedulers that can end a wait:
+// - SchedulerWithdraw: the registration is withdrawn and the coroutine resumed inline,
+//   await_resume() of the awaiters below then returns false. If the scheduler already
+//   took the coroutine, it resumes it and the wait completes normally.
+// - SchedulerCancel: the scheduler ends the wait and resumes the coroutine itself, the
+//   outcome is reported through the awaiter's value (e.g. -ECANCELED).
+// A wait starting once cancellation was requested is abandoned if a race owns the
+// coroutine, or else still gives up the thread before it returns false, see
+// yield_cancelled(), so a coroutine ignoring the result can neither spin nor hold up
+// any_of.
+class CancellableWait {
+   protected:
+    // true if cancellation was requested before the wait was registered
+    template <typename CallerPromiseType>
+    bool cancellation_requested(std::coroutine_handle<CallerPromiseType> caller) noexcept {
+        if constexpr (PromiseCancellationConcept<CallerPromiseType>) {
+            token_ = caller.promise().get_cancellation_token();
+        }
+        cancelled_ = token_.cancellation_requested();
+        return cancelled_;
+    }
+
+    // called right before registering: once registered, the coroutine may already run
+    // on another thread. node is the SchedulerNode to register, nullptr for the handle.
+    // false if cancellation was requested meanwhile, the wait must not be registered then
+    bool watch_cancellation(std::coroutine_handle<> handle, const Scheduler& sched,
+                            SchedulerNode* node) noexcept {
+        if (!token_.can_be_cancelled() || !(sched.can_withdraw() || sched.can_cancel())) {
+            return true;
+        }
+        handle_ = handle;
+        sched_ = sched;
+        node_ = node;
+        if (!callback_.arm(token_, &on_cancel, this)) {
+            cancelled_ = true;
+            return false;
+        }
+        return true;
+    }
+
+    // for a wait that found cancellation requested: leaves the coroutine suspended if
+    // its race abandons it, or else registers it without a value, or with a zero
+    // deadline on a timer, so that it resumes as cancelled once the others had their
+    // turn. false if the scheduler takes neither, the coroutine goes on right away then.
+    template <typename ValueT = void>
+    bool yield_cancelled(std::coroutine_handle<> handle, Scheduler& sched,
+                         SchedulerNode* node) noexcept {
+        if (token_.abandon()) {
+            return true;
+        }
+        if (!sched.can_yield()) {
+            if constexpr (std::is_same_v<ValueT, std::chrono::nanoseconds>) {
+                if (node) {
+                    scheduler_register_node(sched, *node, std::chrono::nanoseconds{0});
+                } else {
+                    scheduler_register_coro(sched, handle, std::chrono::nanoseconds{0});
+                }
+                return true;
+            }
+            return false;
+        }
+        if (node) {
+            scheduler_register_node(sched, *node);
+        } else {
+            scheduler_register_coro(sched, handle);
+        }
+        return true;
+    }
+
+    // false if the wait was cancelled
+    bool finish_wait() noexcept {
+        callback_.reset();
+        return !cancelled_;
+    }
+
+   private:
+    static void on_cancel(void* self) {
+        auto& wait = *static_cast<CancellableWait*>(self);
+        if (!wait.sched_.can_withdraw()) {
+            scheduler_cancel_coro(wait.sched_, wait.handle_);
+            return;
+        }
+        bool withdrawn = wait.node_ ? scheduler_unregister_node(wait.sched_, *wait.node_)
+                                    : scheduler_unregister_coro(wait.sched_, wait.handle_);
+        if (withdrawn) {
+            wait.cancelled_ = true;
+            wait.handle_.resume();
+        }
+    }
+
+    CancellationToken token_;
+    CancellationCallback callback_;
+    std::coroutine_handle<> handle_{nullptr};
+    Scheduler sched_;
+    SchedulerNode* node_{nullptr};
+    bool cancelled_{false};
+};
+
 template <typename ValueT>
-struct SchedulerAwaiter {
+struct SchedulerAwaiter : CancellableWait {
     SchedulerAwaiter(ValueT&& value) : value_(std::move(value)) {}
     SchedulerAwaiter(const ValueT& value) : value_(value) {}
 
     constexpr bool await_ready() const noexcept { return false; }
 
     template <shcoro::PromiseSchedulerConcept CallerPromiseType>
-    auto await_suspend(std::coroutine_handle<CallerPromiseType> caller) noexcept {
-        scheduler_register_coro(caller.promise().get_scheduler(), caller, std::move(value_));
+    bool await_suspend(std::coroutine_handle<CallerPromiseType> caller) noexcept {
+        auto& sched = caller.promise().get_scheduler();
+        if constexpr (PromiseSchedulerNodeConcept<CallerPromiseType>) {
+            auto& node = caller.promise().get_scheduler_node();
+            node.handle_ = caller;
+            if (cancellation_requested(caller) ||
+                !watch_cancellation(caller, sched, &node)) {
+                return yield_cancelled<ValueT>(caller, sched, &node);
+            }
+            scheduler_register_node(sched, node, value_);
+        } else {
+            if (cancellation_requested(caller) ||
+                !watch_cancellation(caller, sched, nullptr)) {
+                return yield_cancelled<ValueT>(caller, sched, nullptr);
+            }
+            scheduler_register_coro(sched, caller, std::move(value_));
+        }
+        return true;
     }
 
-    void await_resume() const noexcept {}
+    // false if the wait was cancelled
+    [[nodiscard]] bool await_resume() noexcept { return finish_wait(); }
 
     ValueT value_;
 };
 
 template <>
-struct SchedulerAwaiter<void> {
+struct SchedulerAwaiter<void> : CancellableWait {
     SchedulerAwaiter() = default;
     constexpr bool await_ready() const noexcept { return false; }
     template <shcoro::PromiseSchedulerConcept CallerPromiseType>
-    auto await_suspend(std::coroutine_handle<CallerPromiseType> caller) noexcept {
-        scheduler_register_coro(caller.promise().get_scheduler(), caller);
+    bool await_suspend(std::coroutine_handle<CallerPromiseType> caller) noexcept {
+        auto& sched = caller.promise().get_scheduler();
+        if constexpr (PromiseSchedulerNodeConcept<CallerPromiseType>) {
+            auto& node = caller.promise().get_scheduler_node();
+            node.handle_ = caller;
+            if (cancellation_requested(caller) ||
+                !watch_cancellation(caller, sched, &node)) {
+                return yield_cancelled(caller, sched, &node);
+            }
+            scheduler_register_node(sched, node);
+        } else {
+            if (cancellation_requested(caller) ||
+                !watch_cancellation(caller, sched, nullptr)) {
+                return yield_cancelled(caller, sched, nullptr);
+            }
+            scheduler_register_coro(sched, caller);
+        }
+        return true;
     }
-    void await_resume() const noexcept {}
+    [[nodiscard]] bool await_resume() noexcept { return finish_wait(); }
 };
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+
+namespace shcoro {
+
+// Intrusive link embedded in promise_scheduler_base. Schedulers modelling
+// SchedulerIntrusive queue it directly instead of allocating a node per handle.
+struct SchedulerNode {
+    bool linked() const noexcept { return next_ != nullptr; }
+
+    void unlink() noexcept {
+        prev_->next_ = next_;
+        next_->prev_ = prev_;
+        prev_ = next_ = nullptr;
+    }
+
+    SchedulerNode* prev_{nullptr};
+    SchedulerNode* next_{nullptr};
+    std::coroutine_handle<> handle_{};
+    uint64_t key_{0};  // scheduler defined, e.g. the expiry tick of a timer
+};
+
+// Circular doubly linked list of SchedulerNode with a sentinel head
+class SchedulerNodeList {
+   public:
+    SchedulerNodeList() noexcept { head_.prev_ = head_.next_ = &head_; }
+    SchedulerNodeList(const SchedulerNodeList&) = delete;
+    SchedulerNodeList& operator=(const SchedulerNodeList&) = delete;
+
+    bool empty() const noexcept { return head_.next_ == &head_; }
+
+    SchedulerNode& front() noexcept { return *head_.next_; }
+
+    void push_back(SchedulerNode& node) noexcept {
+        node.prev_ = head_.prev_;
+        node.next_ = &head_;
+        head_.prev_->next_ = &node;
+        head_.prev_ = &node;
+    }
+
+    SchedulerNode& pop_front() noexcept {
+        auto& node = front();
+        node.unlink();
+        return node;
+    }
+
+    // moves all nodes of other to the back of this list
+    void splice(SchedulerNodeList& other) noexcept {
+        if (other.empty()) return;
+        auto* first = other.head_.next_;
+        auto* last = other.head_.prev_;
+        other.head_.prev_ = other.head_.next_ = &other.head_;
+
+        first->prev_ = head_.prev_;
+        last->next_ = &head_;
+        head_.prev_->next_ = first;
+        head_.prev_ = last;
+    }
+
+   private:
+    SchedulerNode head_;
+};
+
+// Heap allocated nodes for handles registered without an embedded SchedulerNode
+class ForeignSchedulerNodes {
+   public:
+    ForeignSchedulerNodes() = default;
+    ForeignSchedulerNodes(const ForeignSchedulerNodes&) = delete;
+    ForeignSchedulerNodes& operator=(const ForeignSchedulerNodes&) = delete;
+
+    ~ForeignSchedulerNodes() {
+        for (auto& [addr, node] : nodes_) {
+            delete node;
+        }
+    }
+
+    bool empty() const noexcept { return nodes_.empty(); }
+
+    // a handle acquired again gets its existing node back, the scheduler takes it out of
+    // its queue before queueing it again
+    SchedulerNode& acquire(std::coroutine_handle<> handle) {
+        auto [it, inserted] = nodes_.try_emplace(handle.address(), nullptr);
+        if (inserted) {
+            it->second = new SchedulerNode{.handle_ = handle};
+        }
+        return *it->second;
+    }
+
+    SchedulerNode* find(std::coroutine_handle<> handle) const {
+        auto it = nodes_.find(handle.address());
+        return it != nodes_.end() ? it->second : nullptr;
+    }
+
+    // frees node if it was acquired here, nodes embedded in promises are left alone
+    void release(SchedulerNode& node) {
+        if (nodes_.empty()) [[likely]] {
+            return;
+        }
+        auto it = nodes_.find(node.handle_.address());
+        if (it != nodes_.end() && it->second == &node) {
+            nodes_.erase(it);
+            delete &node;
+        }
+    }
+
+   private:
+    std::unordered_map<void*, SchedulerNode*> nodes_;
+};
+
+}  // namespace shcoro
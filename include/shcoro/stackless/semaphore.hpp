@@ -0,0 +1,289 @@
+#pragma once
+
+#include <coroutine>
+#include <cstddef>
+#include <mutex>
+#include <utility>
+
+#include "shcoro/utils/noncopyable.h"
+#include "shcoro/utils/null_lock.h"
+#include "waiter.hpp"
+
+namespace shcoro {
+// Counting coroutine semaphore. A released unit is handed to the oldest waiter directly,
+// release(n) wakes up to n waiters in one pass.
+// LockT guards the count and the waiters: the default NullLock is for a single thread,
+// AsyncSemaphore<std::mutex> may be acquired and released from different threads.
+// Waiters are always woken with the lock released.
+template <typename LockT = NullLock>
+class AsyncSemaphore final : noncopyable {
+   public:
+    struct AcquireAwaiter : Waiter {
+        AcquireAwaiter(AsyncSemaphore* sem) : sem_(sem) {}
+
+        bool await_ready() noexcept { return sem_->try_acquire(); }
+
+        // the count is checked again under the lock, a release may have come in between
+        template <typename CallerPromiseType>
+        bool await_suspend(std::coroutine_handle<CallerPromiseType> caller) noexcept {
+            set_waiter(caller);
+            {
+                std::lock_guard guard(sem_->mutex_);
+                if (sem_->count_ != 0) {
+                    sem_->count_--;
+                    return false;
+                }
+                if (watch_cancellation(&on_cancel, this)) {
+                    sem_->waiting_list_.push(*this);
+                    return true;
+                }
+            }
+            return yield_cancelled();
+        }
+
+        // the unit was taken in await_ready / await_suspend or handed over by release,
+        // false if the wait was cancelled and no unit is held
+        [[nodiscard]] bool await_resume() noexcept { return !cancelled_; }
+
+        static void on_cancel(void* self) {
+            auto& awaiter = *static_cast<AcquireAwaiter*>(self);
+            bool removed = false;
+            {
+                std::lock_guard guard(awaiter.sem_->mutex_);
+                removed = awaiter.sem_->waiting_list_.remove(awaiter);
+            }
+            if (removed) {
+                awaiter.cancel();
+            }
+        }
+
+        AsyncSemaphore* sem_{nullptr};
+        AcquireAwaiter* next_{nullptr};
+    };
+
+    explicit AsyncSemaphore(size_t count,
+                            WakeupPolicy policy = WakeupPolicy::INLINE) noexcept
+        : count_(count), policy_(policy) {}
+    ~AsyncSemaphore() = default;
+
+    bool try_acquire() noexcept {
+        std::lock_guard guard(mutex_);
+        if (count_ == 0) {
+            return false;
+        }
+        count_--;
+        return true;
+    }
+
+    [[nodiscard]] AcquireAwaiter acquire() { return AcquireAwaiter(this); }
+
+    void release() { release(1); }
+
+    void release(size_t n) {
+        WaiterQueue<AcquireAwaiter> woken;
+        {
+            std::lock_guard guard(mutex_);
+            for (; n != 0 && !waiting_list_.empty(); n--) {
+                woken.push(waiting_list_.pop());
+            }
+            count_ += n;
+        }
+        while (!woken.empty()) {
+            woken.pop().wake(policy_);
+        }
+    }
+
+    size_t available() {
+        std::lock_guard guard(mutex_);
+        return count_;
+    }
+
+    using ScopedUnit = ScopedLockGuard<AsyncSemaphore, &AsyncSemaphore::release>;
+
+    struct ScopedAcquireAwaiter : AcquireAwaiter {
+        using AcquireAwaiter::AcquireAwaiter;
+        ScopedUnit await_resume() noexcept {
+            return this->cancelled_ ? ScopedUnit() : ScopedUnit(*this->sem_);
+        }
+    };
+
+    // co_await sem.scoped_acquire() returns a guard that releases one unit on destruction,
+    // an empty one if the wait was cancelled
+    [[nodiscard]] ScopedAcquireAwaiter scoped_acquire() {
+        return ScopedAcquireAwaiter(this);
+    }
+
+   private:
+    LockT mutex_;
+    WaiterQueue<AcquireAwaiter> waiting_list_;
+    size_t count_;
+    WakeupPolicy policy_;
+};
+
+// Single use countdown: wait() suspends until count_down() brought the count to zero,
+// then every waiter is woken in one pass. A wait is withdrawn when cancellation of its
+// coroutine is requested. LockT as for AsyncSemaphore.
+template <typename LockT = NullLock>
+class AsyncLatch final : noncopyable {
+   public:
+    struct WaitAwaiter : Waiter {
+        WaitAwaiter(AsyncLatch* latch) : latch_(latch) {}
+
+        bool await_ready() noexcept { return latch_->try_wait(); }
+
+        template <typename CallerPromiseType>
+        bool await_suspend(std::coroutine_handle<CallerPromiseType> caller) noexcept {
+            set_waiter(caller);
+            {
+                std::lock_guard guard(latch_->mutex_);
+                if (latch_->count_ == 0) {
+                    return false;
+                }
+                if (watch_cancellation(&on_cancel, this)) {
+                    latch_->waiting_list_.push(*this);
+                    return true;
+                }
+            }
+            return yield_cancelled();
+        }
+
+        // false if the wait was cancelled before the count reached zero
+        [[nodiscard]] bool await_resume() noexcept { return !cancelled_; }
+
+        static void on_cancel(void* self) {
+            auto& awaiter = *static_cast<WaitAwaiter*>(self);
+            bool removed = false;
+            {
+                std::lock_guard guard(awaiter.latch_->mutex_);
+                removed = awaiter.latch_->waiting_list_.remove(awaiter);
+            }
+            if (removed) {
+                awaiter.cancel();
+            }
+        }
+
+        AsyncLatch* latch_{nullptr};
+        WaitAwaiter* next_{nullptr};
+    };
+
+    explicit AsyncLatch(size_t count, WakeupPolicy policy = WakeupPolicy::INLINE) noexcept
+        : count_(count), policy_(policy) {}
+    ~AsyncLatch() = default;
+
+    void count_down(size_t n = 1) {
+        WaiterQueue<WaitAwaiter> woken;
+        {
+            std::lock_guard guard(mutex_);
+            if (count_ == 0) {
+                return;
+            }
+            count_ = n < count_ ? count_ - n : 0;
+            if (count_ != 0) {
+                return;
+            }
+            woken = std::exchange(waiting_list_, {});
+        }
+        while (!woken.empty()) {
+            woken.pop().wake(policy_);
+        }
+    }
+
+    bool try_wait() noexcept {
+        std::lock_guard guard(mutex_);
+        return count_ == 0;
+    }
+
+    [[nodiscard]] WaitAwaiter wait() { return WaitAwaiter(this); }
+
+   private:
+    LockT mutex_;
+    WaiterQueue<WaitAwaiter> waiting_list_;
+    size_t count_;
+    WakeupPolicy policy_;
+};
+
+// Reusable rendezvous of a fixed number of coroutines: the last one to arrive_and_wait()
+// in a phase wakes the others in one pass and continues without suspending, then the
+// next phase starts. A waiting arrival is withdrawn when cancellation of its coroutine is
+// requested. LockT as for AsyncSemaphore.
+template <typename LockT = NullLock>
+class AsyncBarrier final : noncopyable {
+   public:
+    struct ArriveAwaiter : Waiter {
+        ArriveAwaiter(AsyncBarrier* barrier) : barrier_(barrier) {}
+
+        constexpr bool await_ready() const noexcept { return false; }
+
+        template <typename CallerPromiseType>
+        bool await_suspend(std::coroutine_handle<CallerPromiseType> caller) noexcept {
+            set_waiter(caller);
+            WaiterQueue<ArriveAwaiter> woken;
+            {
+                std::lock_guard guard(barrier_->mutex_);
+                if (barrier_->arrived_ + 1 != barrier_->expected_) {
+                    if (watch_cancellation(&on_cancel, this)) {
+                        barrier_->arrived_++;
+                        barrier_->waiting_list_.push(*this);
+                        return true;
+                    }
+                } else {
+                    barrier_->arrived_ = 0;
+                    barrier_->phase_++;
+                    woken = std::exchange(barrier_->waiting_list_, {});
+                }
+            }
+            if (cancelled_) {
+                return yield_cancelled();
+            }
+            auto policy = barrier_->policy_;
+            while (!woken.empty()) {
+                woken.pop().wake(policy);
+            }
+            return false;
+        }
+
+        // false if the wait was cancelled, the arrival is withdrawn then and the phase
+        // still needs expected coroutines
+        [[nodiscard]] bool await_resume() noexcept { return !cancelled_; }
+
+        static void on_cancel(void* self) {
+            auto& awaiter = *static_cast<ArriveAwaiter*>(self);
+            bool removed = false;
+            {
+                std::lock_guard guard(awaiter.barrier_->mutex_);
+                removed = awaiter.barrier_->waiting_list_.remove(awaiter);
+                if (removed) {
+                    awaiter.barrier_->arrived_--;
+                }
+            }
+            if (removed) {
+                awaiter.cancel();
+            }
+        }
+
+        AsyncBarrier* barrier_{nullptr};
+        ArriveAwaiter* next_{nullptr};
+    };
+
+    explicit AsyncBarrier(size_t expected,
+                          WakeupPolicy policy = WakeupPolicy::INLINE) noexcept
+        : expected_(expected), policy_(policy) {}
+    ~AsyncBarrier() = default;
+
+    [[nodiscard]] ArriveAwaiter arrive_and_wait() { return ArriveAwaiter(this); }
+
+    // number of completed phases
+    size_t phase() {
+        std::lock_guard guard(mutex_);
+        return phase_;
+    }
+
+   private:
+    LockT mutex_;
+    WaiterQueue<ArriveAwaiter> waiting_list_;
+    size_t expected_;
+    size_t arrived_{0};
+    size_t phase_{0};
+    WakeupPolicy policy_;
+};
+}  // namespace shcoro
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <chrono>
+#include <coroutine>
+#include <type_traits>
+#include <utility>
+
+#include "async.hpp"
+#include "awaiter_concepts.hpp"
+#include "cancellation.hpp"
+#include "mux_control.hpp"
+#include "promise_concepts.hpp"
+#include "shcoro/utils/expected.h"
+#include "shcoro/utils/noncopyable.h"
+#include "timer.hpp"
+
+namespace shcoro {
+
+// error returned by with_timeout
+struct timeout {};
+
+namespace detail {
+// the deadline racing the task of a with_timeout, false if cancelled before expiring
+inline Async<bool> expire_after(std::chrono::nanoseconds duration) {
+    bool expired = co_await TimedAwaiter{duration};
+    co_return expired;
+}
+}  // namespace detail
+
+// co_await with_timeout(task, 50ms) runs task and returns expected<T, timeout>.
+// The task races a deadline coroutine waiting on the scheduler of the awaiting coroutine
+// (which must accept std::chrono::nanoseconds, e.g. a TimedScheduler or an EventLoop).
+// Both report to a MuxControl embedded in the awaiter and the deadline frame comes from
+// the frame pool, so nothing else is allocated. Whichever finishes first cancels the
+// other: a finished task withdraws the timer registration, an expired deadline cancels
+// the task through its CancellationToken. A task that keeps waiting after that (e.g. a
+// loop ignoring the results) is abandoned in its next wait and destroyed with the
+// awaiter, so with_timeout returns on schedule; only a task blocked in a wait that does
+// not observe cancellation (e.g. a custom awaiter) delays it until that wait completes.
+// Cancelling the awaiting coroutine cancels the task but not the deadline: with_timeout
+// returns whatever the task returned once it unwound, or timeout if it did not by then.
+template <ContinuationAwaiterConcept TaskT>
+class [[nodiscard]] TimeoutAwaiter : noncopyable {
+   public:
+    using value_type = awaiter_return_t<TaskT>;
+
+    TimeoutAwaiter(TaskT task, std::chrono::nanoseconds duration)
+        : task_(std::move(task)), deadline_(detail::expire_after(duration)) {}
+
+    constexpr bool await_ready() const noexcept { return false; }
+
+    template <PromiseSchedulerConcept CallerPromiseType>
+    bool await_suspend(std::coroutine_handle<CallerPromiseType> caller) {
+        if constexpr (PromiseCancellationConcept<CallerPromiseType>) {
+            auto token = caller.promise().get_cancellation_token();
+            if (!forward_cb_.arm(token, &cancel_task, this)) {
+                task_cancel_.request_cancellation();
+            }
+        }
+        control_.start_race(caller, 2, cancel_);
+        // the race cancels the task through its own source, which the caller's
+        // cancellation reaches without cancelling the deadline
+        task_cancel_.set_abandon_handler(&MuxControl::abandon, &control_);
+        race_cb_.arm(cancel_.token(), &cancel_task, this);
+        start(task_, caller, 0, task_cancel_.token());
+        // the deadline is not started for a task that finished right away
+        size_t skipped = 1;
+        if (!control_.done()) {
+            start(deadline_, caller, 1, cancel_.token());
+            skipped = 0;
+        }
+        return !control_.started(skipped);
+    }
+
+    expected<value_type, timeout> await_resume() {
+        forward_cb_.reset();
+        race_cb_.reset();
+        // only the caller's cancellation leaves the deadline running, so it wins only
+        // by expiring; an abandoned task has no result
+        if (control_.first() == 1) {
+            return unexpected(timeout{});
+        }
+        if constexpr (std::is_void_v<value_type>) {
+            task_.await_resume();
+            return {};
+        } else {
+            return task_.await_resume();
+        }
+    }
+
+   private:
+    template <typename T, typename CallerPromiseType>
+    void start(T& task, std::coroutine_handle<CallerPromiseType> caller, size_t index,
+               CancellationToken token) {
+        task.set_cancellation_token(token);
+        auto handle = task.await_suspend(caller);
+        handle.promise().set_control(&control_, index);
+        handle.resume();
+    }
+
+    static void cancel_task(void* self) {
+        static_cast<TimeoutAwaiter*>(self)->task_cancel_.request_cancellation();
+    }
+
+    TaskT task_;
+    Async<bool> deadline_;
+    MuxControl control_;
+    CancellationSource cancel_;  // the race, cancels the deadline
+    CancellationSource task_cancel_;
+    CancellationCallback forward_cb_;
+    CancellationCallback race_cb_;
+};
+
+template <ContinuationAwaiterConcept TaskT, class Rep, class Period>
+TimeoutAwaiter<TaskT> with_timeout(TaskT task,
+                                   std::chrono::duration<Rep, Period> duration) {
+    return TimeoutAwaiter<TaskT>(
+        std::move(task), std::chrono::duration_cast<std::chrono::nanoseconds>(duration));
+}
+
+}  // namespace shcoro
@@ -1,9 +1,10 @@
 #pragma once
 
-#include <sys/time.h>
-
 #include <chrono>
+#include <condition_variable>
 #include <coroutine>
+#include <ctime>
+#include <mutex>
 #include <set>
 #include <unordered_map>
 
@@ -12,93 +13,163 @@
 #include "shcoro/utils/logger.h"
 
 namespace shcoro {
-class TimedScheduler {
+// Resumes coroutines once their deadline on Clock has passed. Durations are kept in
+// nanoseconds; time_t overloads take seconds.
+// run() blocks until the earliest deadline instead of spinning. register_coro and
+// unregister_coro may be called from other threads, registering an earlier deadline
+// wakes the sleeping run loop. Coroutines are always resumed on the run() thread.
+template <typename Clock>
+class BasicTimedScheduler {
    public:
-    using value_type = time_t;
+    using value_type = std::chrono::nanoseconds;
+    using clock = Clock;
+
+    void register_coro(std::coroutine_handle<> coro, std::chrono::nanoseconds duration) {
+        SHCORO_LOG("timer register: ", duration.count(), "ns");
+        auto deadline =
+            clock::now() + std::chrono::duration_cast<typename clock::duration>(duration);
+        bool earliest = false;
+        {
+            std::lock_guard<std::mutex> guard(mutex_);
+            auto [it, suc] = coros_.insert({deadline, coro});
+            coro_map_[coro.address()] = it;
+            earliest = (it == coros_.begin());
+        }
+        if (earliest) {
+            cv_.notify_one();
+        }
+    }
 
     void register_coro(std::coroutine_handle<> coro, time_t duration) {
-        SHCORO_LOG("timer register: ", duration);
-        auto [it, suc] = coros_.insert(
-            {std::chrono::system_clock::to_time_t(std::chrono::system_clock::now()) +
-                 duration,
-             coro});
-        coro_map_[coro.address()] = it;
+        register_coro(coro, std::chrono::nanoseconds(std::chrono::seconds(duration)));
     }
 
-    void unregister_coro(std::coroutine_handle<> coro) {
-        auto addr = coro.address();
-        if (coro_map_.find(addr) != coro_map_.end()) {
-            SHCORO_LOG("timer unregister");
-            coros_.erase(coro_map_[addr]);
-            coro_map_.erase(addr);
-        }
+    // true if coro was waiting, it will not be resumed then
+    bool unregister_coro(std::coroutine_handle<> coro) {
+        std::lock_guard<std::mutex> guard(mutex_);
+        return unregister_locked(coro);
     }
 
+    // resumes at most one expired coroutine, never blocks
     void run_once() {
+        std::unique_lock<std::mutex> lock(mutex_);
         if (!coros_.empty()) {
             SHCORO_LOG("remaining task: ", coros_.size());
             auto it = coros_.begin();
-            time_t cur =
-                std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-            if (it->first > cur) {
+            if (it->first > clock::now()) {
                 return;
             }
-            auto handle = it->second;
-            SHCORO_LOG("unregister handle");
-            unregister_coro(handle);
-            SHCORO_LOG("resume handle");
-            handle.resume();
+            resume_locked(lock, it->second);
         }
     }
 
     void run() {
+        std::unique_lock<std::mutex> lock(mutex_);
         while (!coros_.empty()) {
             SHCORO_LOG("remaining task: ", coros_.size());
             auto it = coros_.begin();
-            time_t cur =
-                std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-            if (it->first > cur) {
+            if (it->first > clock::now()) {
+                // woken up early by register_coro when an earlier deadline shows up.
+                // The entry may be unregistered while waiting, keep a copy of its time.
+                auto deadline = it->first;
+                cv_.wait_until(lock, deadline);
                 continue;
             }
-            auto handle = it->second;
-            SHCORO_LOG("unregister handle");
-            unregister_coro(handle);
-            SHCORO_LOG("resume handle");
-            handle.resume();
+            resume_locked(lock, it->second);
         }
     }
 
+    size_t pending_number() const {
+        std::lock_guard<std::mutex> guard(mutex_);
+        return coros_.size();
+    }
+
    private:
-    std::set<std::pair<time_t, std::coroutine_handle<>>> coros_;
-    std::unordered_map<void*, decltype(coros_)::iterator> coro_map_;
+    bool unregister_locked(std::coroutine_handle<> coro) {
+        auto it = coro_map_.find(coro.address());
+        if (it == coro_map_.end()) {
+            return false;
+        }
+        SHCORO_LOG("timer unregister");
+        coros_.erase(it->second);
+        coro_map_.erase(it);
+        return true;
+    }
+
+    // the lock is released while the coroutine runs so that it can register again
+    void resume_locked(std::unique_lock<std::mutex>& lock, std::coroutine_handle<> handle) {
+        SHCORO_LOG("unregister handle");
+        unregister_locked(handle);
+        lock.unlock();
+        SHCORO_LOG("resume handle");
+        handle.resume();
+        lock.lock();
+    }
+
+    std::set<std::pair<typename clock::time_point, std::coroutine_handle<>>> coros_;
+    std::unordered_map<void*, typename decltype(coros_)::iterator> coro_map_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
 };
 
-struct TimedAwaiter : SchedulerAwaiter<time_t> {
-    using SchedulerAwaiter::SchedulerAwaiter;
+// wall clock deadlines
+using TimedScheduler = BasicTimedScheduler<std::chrono::system_clock>;
+// monotonic deadlines, not affected by wall clock jumps
+using SteadyTimedScheduler = BasicTimedScheduler<std::chrono::steady_clock>;
 
-    TimedAwaiter(TimedScheduler* sched, time_t duration)
-        : SchedulerAwaiter{duration}, scheduler_(sched) {}
-    TimedAwaiter(TimedScheduler& sched, time_t duration)
-        : SchedulerAwaiter{duration}, scheduler_(&sched) {}
+// A scheduler taking a relative deadline, e.g. BasicTimedScheduler or EventLoop
+template <class SchedulerT>
+concept SchedulerDeadline = SchedulerConcept<SchedulerT> &&
+                            detail::accepts_value<SchedulerT, std::chrono::nanoseconds>;
+
+// co_await TimedAwaiter{5ms} or TimedAwaiter{seconds}, false if cancelled before expiring
+struct TimedAwaiter : SchedulerAwaiter<std::chrono::nanoseconds> {
+    template <class Rep, class Period>
+    TimedAwaiter(std::chrono::duration<Rep, Period> duration)
+        : SchedulerAwaiter{
+              std::chrono::duration_cast<std::chrono::nanoseconds>(duration)} {}
+    TimedAwaiter(time_t seconds) : TimedAwaiter{std::chrono::seconds(seconds)} {}
+
+    template <SchedulerDeadline SchedulerT, class Duration>
+    TimedAwaiter(SchedulerT* sched, Duration duration)
+        : TimedAwaiter{duration} {
+        scheduler_ = *sched;
+    }
+    template <SchedulerDeadline SchedulerT, class Duration>
+    TimedAwaiter(SchedulerT& sched, Duration duration)
+        : TimedAwaiter{duration} {
+        scheduler_ = sched;
+    }
 
     template <shcoro::PromiseSchedulerConcept CallerPromiseType>
-    auto await_suspend(std::coroutine_handle<CallerPromiseType> caller) noexcept {
+    bool await_suspend(std::coroutine_handle<CallerPromiseType> caller) noexcept {
+        if (!scheduler_) {
+            return SchedulerAwaiter::await_suspend(caller);
+        }
+        return register_on_own_scheduler(caller);
+    }
+
+    template <typename CallerPromiseType>
+    bool await_suspend(std::coroutine_handle<CallerPromiseType> caller) noexcept {
         if (!scheduler_) {
-            scheduler_register_coro(caller.promise().get_scheduler(), caller,
-                                    std::move(value_));
-        } else {
-            scheduler_->register_coro(caller, value_);
+            return true;
         }
+        return register_on_own_scheduler(caller);
     }
 
+   private:
     template <typename CallerPromiseType>
-    auto await_suspend(std::coroutine_handle<CallerPromiseType> caller) noexcept {
-        if (scheduler_) {
-            scheduler_->register_coro(caller, value_);
-        }   
+    bool register_on_own_scheduler(std::coroutine_handle<CallerPromiseType> caller) {
+        if (cancellation_requested(caller) ||
+            !watch_cancellation(caller, scheduler_, nullptr)) {
+            return yield_cancelled<std::chrono::nanoseconds>(caller, scheduler_, nullptr);
+        }
+        scheduler_register_coro(scheduler_, caller, value_);
+        return true;
     }
 
-    TimedScheduler* scheduler_{nullptr};
+   public:
+    Scheduler scheduler_;
 };
 
 }  // namespace shcoro
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <coroutine>
+#include <ctime>
+#include <optional>
+#include <thread>
+
+#include "promise_concepts.hpp"
+#include "scheduler_awaiter.hpp"
+#include "scheduler_node.hpp"
+#include "shcoro/utils/logger.h"
+#include "shcoro/utils/noncopyable.h"
+
+namespace shcoro {
+// Hierarchical timing wheel (Varghese & Lauck) with the same contract as
+// SteadyTimedScheduler. 4 levels of 256 slots over a configurable tick (1ms by default).
+// Insert and cancel are O(1) on the SchedulerNode embedded in the promise, all timers
+// of a slot are expired in one batch, and far timers cascade down one level every
+// 256^level ticks.
+class TimingWheelScheduler : noncopyable {
+   public:
+    using value_type = std::chrono::nanoseconds;
+    using clock = std::chrono::steady_clock;
+
+    static constexpr size_t slot_bits = 8;
+    static constexpr size_t slot_num = size_t{1} << slot_bits;
+    static constexpr size_t level_num = 4;
+
+    explicit TimingWheelScheduler(
+        std::chrono::nanoseconds tick = std::chrono::milliseconds(1))
+        : tick_(std::max(tick, std::chrono::nanoseconds(1))), start_(clock::now()) {}
+
+    ~TimingWheelScheduler() {
+        for (auto& level : wheels_) {
+            for (auto& slot : level) {
+                while (!slot.empty()) {
+                    foreign_.release(slot.pop_front());
+                }
+            }
+        }
+    }
+
+    void register_node(SchedulerNode& node, std::chrono::nanoseconds duration) {
+        SHCORO_LOG("timing wheel register: ", duration.count(), "ns");
+        node.key_ = expiry_tick(std::max(duration, std::chrono::nanoseconds(0)));
+        insert(node);
+        pending_++;
+    }
+
+    void register_node(SchedulerNode& node, time_t duration) {
+        register_node(node, std::chrono::nanoseconds(std::chrono::seconds(duration)));
+    }
+
+    bool unregister_node(SchedulerNode& node) {
+        if (node.linked()) {
+            SHCORO_LOG("timing wheel unregister");
+            node.unlink();
+            pending_--;
+            return true;
+        }
+        return !foreign_.empty() && unregister_coro(node.handle_);
+    }
+
+    // registered again while pending, the new deadline replaces the earlier one
+    void register_coro(std::coroutine_handle<> coro, std::chrono::nanoseconds duration) {
+        auto& node = foreign_.acquire(coro);
+        if (node.linked()) {
+            node.unlink();
+            pending_--;
+        }
+        register_node(node, duration);
+    }
+
+    void register_coro(std::coroutine_handle<> coro, time_t duration) {
+        register_coro(coro, std::chrono::nanoseconds(std::chrono::seconds(duration)));
+    }
+
+    bool unregister_coro(std::coroutine_handle<> coro) {
+        auto* node = foreign_.find(coro);
+        if (!node) {
+            return false;
+        }
+        node->unlink();
+        pending_--;
+        foreign_.release(*node);
+        return true;
+    }
+
+    // expires every timer that is due, never blocks
+    void run_once() { advance(now_tick()); }
+
+    // expires timers until none is pending, sleeping until the next non-empty slot
+    void run() {
+        while (pending_ != 0) {
+            advance(now_tick());
+            if (pending_ != 0) {
+                std::this_thread::sleep_until(tick_time(next_event_tick()));
+            }
+        }
+    }
+
+    size_t pending_number() const { return pending_; }
+
+    // when run_once() has work to do next, nullopt if no timer is pending
+    std::optional<clock::time_point> next_expiry() const {
+        if (pending_ == 0) {
+            return std::nullopt;
+        }
+        return tick_time(next_event_tick());
+    }
+
+   private:
+    uint64_t now_tick() const {
+        return static_cast<uint64_t>((clock::now() - start_) / tick_);
+    }
+
+    clock::time_point tick_time(uint64_t tick) const {
+        return start_ + std::chrono::duration_cast<clock::duration>(tick_ * tick);
+    }
+
+    // rounds up so that a timer never fires early
+    uint64_t expiry_tick(std::chrono::nanoseconds duration) const {
+        auto deadline = clock::now() - start_ + duration;
+        auto tick = static_cast<uint64_t>((deadline + tick_ - std::chrono::nanoseconds(1)) /
+                                          tick_);
+        return std::max(tick, current_tick_);
+    }
+
+    void insert(SchedulerNode& node) {
+        uint64_t expiry = std::max(node.key_, current_tick_);
+        uint64_t delta = expiry - current_tick_;
+        if (delta >= (uint64_t{1} << (slot_bits * level_num))) {
+            // out of range, park it in the farthest slot and cascade it again later
+            expiry = current_tick_ + (uint64_t{1} << (slot_bits * level_num)) - 1;
+            delta = expiry - current_tick_;
+        }
+        size_t level = 0;
+        while (level + 1 < level_num &&
+               delta >= (uint64_t{1} << (slot_bits * (level + 1)))) {
+            level++;
+        }
+        wheels_[level][(expiry >> (slot_bits * level)) & (slot_num - 1)].push_back(node);
+    }
+
+    void cascade(size_t level, uint64_t tick) {
+        size_t index = (tick >> (slot_bits * level)) & (slot_num - 1);
+        SchedulerNodeList nodes;
+        nodes.splice(wheels_[level][index]);
+        while (!nodes.empty()) {
+            insert(nodes.pop_front());
+        }
+        if (index == 0 && level + 1 < level_num) {
+            cascade(level + 1, tick);
+        }
+    }
+
+    void advance(uint64_t target) {
+        while (current_tick_ <= target) {
+            // ticks without expiring timers or cascades are skipped
+            uint64_t next = pending_ != 0 ? next_event_tick() : target + 1;
+            if (next > target) {
+                current_tick_ = target + 1;
+                return;
+            }
+            current_tick_ = next;
+            process_tick();
+        }
+    }
+
+    void process_tick() {
+        uint64_t tick = current_tick_;
+        size_t index = tick & (slot_num - 1);
+        if (index == 0) {
+            cascade(1, tick);
+        }
+
+        // timers registered while expiring land in the next tick at the earliest
+        current_tick_ = tick + 1;
+        SchedulerNodeList expired;
+        expired.splice(wheels_[0][index]);
+        while (!expired.empty()) {
+            auto& node = expired.pop_front();
+            pending_--;
+            auto handle = node.handle_;
+            foreign_.release(node);
+            SHCORO_LOG("timing wheel resume handle");
+            handle.resume();
+        }
+    }
+
+    uint64_t next_event_tick() const {
+        // either a non-empty level 0 slot or the next cascade
+        for (uint64_t tick = current_tick_;; tick++) {
+            size_t index = tick & (slot_num - 1);
+            if (index == 0 || !wheels_[0][index].empty()) {
+                return tick;
+            }
+        }
+    }
+
+    std::chrono::nanoseconds tick_;
+    clock::time_point start_;
+    uint64_t current_tick_{0};
+    size_t pending_{0};
+    std::array<std::array<SchedulerNodeList, slot_num>, level_num> wheels_;
+    ForeignSchedulerNodes foreign_;
+};
+
+}  // namespace shcoro
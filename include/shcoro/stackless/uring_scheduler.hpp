@@ -0,0 +1,430 @@
+#pragma once
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#include "async.hpp"
+#include "io_awaiter.hpp"
+#include "shcoro/utils/exception.h"
+#include "shcoro/utils/logger.h"
+#include "shcoro/utils/noncopyable.h"
+
+namespace shcoro {
+
+enum class UringOp : uint8_t {
+    READ,
+    WRITE,
+    ACCEPT,
+    TIMEOUT,
+};
+
+// Value of UringScheduler. The completion result (or -errno) is stored in *result_
+// before the awaiting coroutine is resumed.
+struct UringRequest {
+    UringOp op_;
+    int fd_{-1};
+    void* buf_{nullptr};
+    uint32_t len_{0};
+    uint64_t offset_{static_cast<uint64_t>(-1)};  // -1 uses the file position
+    sockaddr* addr_{nullptr};
+    socklen_t* addrlen_{nullptr};
+    std::chrono::nanoseconds timeout_{0};
+    int* result_{nullptr};
+};
+
+// Completion based IO over io_uring, set up with raw syscalls. Requests registered
+// while running are only written to the submission ring, the whole batch is submitted
+// with a single io_uring_enter per run_once() (or per wait in run()).
+// A coroutine destroyed while its request is in flight gets the request cancelled,
+// buffers it passed must stay alive until then. A cancelled wait (cancel_coro) stays
+// suspended until the request completes and gets its real result, -ECANCELED if the
+// kernel stopped it in time.
+class UringScheduler : noncopyable {
+   public:
+    using value_type = UringRequest;
+
+    explicit UringScheduler(uint32_t entries = 256) {
+        io_uring_params params{};
+        ring_fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+        if (ring_fd_ < 0) {
+            detail::throw_exception(
+                std::system_error(errno, std::system_category(), "io_uring_setup"));
+        }
+        if (!map_rings(params)) {
+            int err = errno;
+            unmap_rings();
+            ::close(ring_fd_);
+            detail::throw_exception(
+                std::system_error(err, std::system_category(), "io_uring mmap"));
+        }
+    }
+
+    ~UringScheduler() {
+        unmap_rings();
+        ::close(ring_fd_);
+    }
+
+    void register_coro(std::coroutine_handle<> coro, const UringRequest& request) {
+        SHCORO_LOG("uring register: op ", static_cast<int>(request.op_));
+        uint64_t index = acquire_operation();
+        auto& op = operations_[index];
+        op.handle_ = coro;
+        op.result_ = request.result_;
+        waiters_[coro.address()] = index;
+        pending_++;
+
+        auto* sqe = get_sqe();
+        sqe->fd = request.fd_;
+        sqe->user_data = index;
+        switch (request.op_) {
+            case UringOp::READ:
+            case UringOp::WRITE:
+                sqe->opcode =
+                    request.op_ == UringOp::READ ? IORING_OP_READ : IORING_OP_WRITE;
+                sqe->addr = reinterpret_cast<uint64_t>(request.buf_);
+                sqe->len = request.len_;
+                sqe->off = request.offset_;
+                break;
+            case UringOp::ACCEPT:
+                sqe->opcode = IORING_OP_ACCEPT;
+                sqe->addr = reinterpret_cast<uint64_t>(request.addr_);
+                sqe->addr2 = reinterpret_cast<uint64_t>(request.addrlen_);
+                sqe->accept_flags = SOCK_CLOEXEC;
+                break;
+            case UringOp::TIMEOUT: {
+                // read by the kernel at submission, so it lives in the operation slot
+                auto ns = std::max(request.timeout_.count(), int64_t{0});
+                op.timeout_ = {.tv_sec = ns / 1000000000, .tv_nsec = ns % 1000000000};
+                sqe->opcode = IORING_OP_TIMEOUT;
+                sqe->fd = -1;
+                sqe->addr = reinterpret_cast<uint64_t>(&op.timeout_);
+                sqe->len = 1;
+                break;
+            }
+        }
+    }
+
+    void unregister_coro(std::coroutine_handle<> coro) {
+        if (waiters_.empty()) [[likely]] {
+            return;
+        }
+        auto it = waiters_.find(coro.address());
+        if (it == waiters_.end()) {
+            return;
+        }
+        SHCORO_LOG("uring cancel: ", it->second);
+        auto& op = operations_[it->second];
+        op.handle_ = nullptr;
+        op.result_ = nullptr;
+        waiters_.erase(it);
+        pending_--;
+        // the slot is freed once the cancelled request completes
+        submit_cancel(op.user_data_);
+    }
+
+    // asks the kernel to stop the request of coro, which is resumed on its completion
+    void cancel_coro(std::coroutine_handle<> coro) {
+        auto it = waiters_.find(coro.address());
+        if (it != waiters_.end()) {
+            SHCORO_LOG("uring cancel request: ", it->second);
+            submit_cancel(operations_[it->second].user_data_);
+        }
+    }
+
+    // submits queued requests and resumes completed ones, never blocks
+    void run_once() {
+        enter(0);
+        reap();
+    }
+
+    // submits and waits for completions until no coroutine is pending
+    void run() {
+        while (pending_ != 0) {
+            if (stashed_.empty() && !cq_ready()) {
+                enter(1);
+            }
+            reap();
+        }
+        if (to_submit_ != 0) {
+            // cancellations of destroyed waiters
+            enter(0);
+        }
+    }
+
+    size_t pending_number() const { return pending_; }
+
+   private:
+    struct Operation {
+        std::coroutine_handle<> handle_{nullptr};
+        int* result_{nullptr};
+        uint64_t user_data_{0};
+        __kernel_timespec timeout_{};
+    };
+
+    static constexpr uint64_t cancel_user_data = ~uint64_t{0};
+
+    static int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+                              unsigned flags) {
+        return static_cast<int>(
+            ::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+    }
+
+    template <typename T>
+    T* ring_ptr(void* ring, uint32_t offset) const noexcept {
+        return reinterpret_cast<T*>(static_cast<char*>(ring) + offset);
+    }
+
+    bool map_rings(const io_uring_params& params) {
+        sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+        cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single) {
+            sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+        }
+
+        sq_ring_ = ::mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+        if (sq_ring_ == MAP_FAILED) return false;
+        if (single) {
+            cq_ring_ = sq_ring_;
+        } else {
+            cq_ring_ = ::mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+            if (cq_ring_ == MAP_FAILED) return false;
+        }
+        sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = ::mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) return false;
+        sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+        sq_head_ = ring_ptr<uint32_t>(sq_ring_, params.sq_off.head);
+        sq_tail_ = ring_ptr<uint32_t>(sq_ring_, params.sq_off.tail);
+        sq_mask_ = *ring_ptr<uint32_t>(sq_ring_, params.sq_off.ring_mask);
+        sq_entries_ = params.sq_entries;
+        sq_array_ = ring_ptr<uint32_t>(sq_ring_, params.sq_off.array);
+        local_sq_tail_ = *sq_tail_;
+
+        cq_head_ = ring_ptr<uint32_t>(cq_ring_, params.cq_off.head);
+        cq_tail_ = ring_ptr<uint32_t>(cq_ring_, params.cq_off.tail);
+        cq_mask_ = *ring_ptr<uint32_t>(cq_ring_, params.cq_off.ring_mask);
+        cqes_ = ring_ptr<io_uring_cqe>(cq_ring_, params.cq_off.cqes);
+        return true;
+    }
+
+    void unmap_rings() {
+        if (sqes_) ::munmap(sqes_, sqes_size_);
+        if (cq_ring_ && cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_) {
+            ::munmap(cq_ring_, cq_ring_size_);
+        }
+        if (sq_ring_ && sq_ring_ != MAP_FAILED) ::munmap(sq_ring_, sq_ring_size_);
+    }
+
+    uint64_t acquire_operation() {
+        uint64_t index;
+        if (!free_operations_.empty()) {
+            index = free_operations_.back();
+            free_operations_.pop_back();
+            operations_[index] = Operation{};
+        } else {
+            // deque keeps the timespec of queued timeouts in place while it grows
+            index = operations_.size();
+            operations_.emplace_back();
+        }
+        operations_[index].user_data_ = index;
+        return index;
+    }
+
+    void submit_cancel(uint64_t user_data) {
+        auto* sqe = get_sqe();
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->addr = user_data;
+        sqe->user_data = cancel_user_data;
+    }
+
+    io_uring_sqe* get_sqe() {
+        auto sq_head = std::atomic_ref(*sq_head_);
+        while (local_sq_tail_ - sq_head.load(std::memory_order_acquire) >= sq_entries_) {
+            // submission ring full, flush the batch early. The kernel refuses it while
+            // the completion ring overflows, so completions are set aside to make room
+            // and the overflow is flushed; reap() resumes them later.
+            stash_completions();
+            enter(0, IORING_ENTER_GETEVENTS);
+        }
+        uint32_t index = local_sq_tail_ & sq_mask_;
+        auto* sqe = &sqes_[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sq_array_[index] = index;
+        local_sq_tail_++;
+        to_submit_++;
+        return sqe;
+    }
+
+    bool cq_ready() const noexcept {
+        return std::atomic_ref(*cq_head_).load(std::memory_order_relaxed) !=
+               std::atomic_ref(*cq_tail_).load(std::memory_order_acquire);
+    }
+
+    // one io_uring_enter for the whole batch of queued requests
+    void enter(unsigned min_complete, unsigned flags = 0) {
+        if (to_submit_ == 0 && min_complete == 0 && flags == 0) {
+            return;
+        }
+        std::atomic_ref(*sq_tail_).store(local_sq_tail_, std::memory_order_release);
+        if (min_complete) {
+            flags |= IORING_ENTER_GETEVENTS;
+        }
+        int ret = io_uring_enter(ring_fd_, to_submit_, min_complete, flags);
+        if (ret < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+                // retried by the next call once completions are reaped
+                return;
+            }
+            detail::throw_exception(
+                std::system_error(errno, std::system_category(), "io_uring_enter"));
+        }
+        SHCORO_LOG("uring submitted: ", ret);
+        to_submit_ -= static_cast<unsigned>(ret);
+    }
+
+    // A resumed waiter may refill the submission ring, so get_sqe() can stash the
+    // remaining completions and advance the head under us: the head is re-read and
+    // the stash drained again after every completion. Stashed ones are older.
+    void reap() {
+        for (;;) {
+            if (!stashed_.empty()) {
+                auto cqe = stashed_.front();
+                stashed_.pop_front();
+                complete(cqe);
+                continue;
+            }
+            uint32_t head = std::atomic_ref(*cq_head_).load(std::memory_order_relaxed);
+            if (head == std::atomic_ref(*cq_tail_).load(std::memory_order_acquire)) {
+                break;
+            }
+            io_uring_cqe cqe = cqes_[head & cq_mask_];
+            std::atomic_ref(*cq_head_).store(head + 1, std::memory_order_release);
+            complete(cqe);
+        }
+    }
+
+    // moves completions out of the ring without resuming anything
+    void stash_completions() {
+        uint32_t head = std::atomic_ref(*cq_head_).load(std::memory_order_relaxed);
+        while (head != std::atomic_ref(*cq_tail_).load(std::memory_order_acquire)) {
+            stashed_.push_back(cqes_[head & cq_mask_]);
+            head++;
+        }
+        std::atomic_ref(*cq_head_).store(head, std::memory_order_release);
+    }
+
+    void complete(const io_uring_cqe& cqe) {
+        if (cqe.user_data == cancel_user_data) {
+            return;
+        }
+        auto& op = operations_[cqe.user_data];
+        auto handle = op.handle_;
+        if (op.result_) {
+            *op.result_ = cqe.res;
+        }
+        free_operations_.push_back(cqe.user_data);
+        if (handle) {
+            waiters_.erase(handle.address());
+            pending_--;
+            SHCORO_LOG("uring resume handle");
+            handle.resume();
+        }
+    }
+
+    int ring_fd_{-1};
+    void* sq_ring_{nullptr};
+    void* cq_ring_{nullptr};
+    size_t sq_ring_size_{0};
+    size_t cq_ring_size_{0};
+    io_uring_sqe* sqes_{nullptr};
+    size_t sqes_size_{0};
+
+    uint32_t* sq_head_{nullptr};
+    uint32_t* sq_tail_{nullptr};
+    uint32_t* sq_array_{nullptr};
+    uint32_t sq_mask_{0};
+    uint32_t sq_entries_{0};
+    uint32_t local_sq_tail_{0};
+    unsigned to_submit_{0};
+
+    uint32_t* cq_head_{nullptr};
+    uint32_t* cq_tail_{nullptr};
+    uint32_t cq_mask_{0};
+    io_uring_cqe* cqes_{nullptr};
+    std::deque<io_uring_cqe> stashed_;  // taken out of the ring by get_sqe
+
+    size_t pending_{0};
+    std::deque<Operation> operations_;
+    std::vector<uint64_t> free_operations_;
+    std::unordered_map<void*, uint64_t> waiters_;
+};
+
+// IO helpers for coroutines running on a UringScheduler. Return the completion result,
+// which is the syscall return value or -errno. A cancelled request still reports what it
+// did (e.g. the bytes read or the accepted fd) if it completed before the cancel, and
+// -ECANCELED otherwise.
+
+inline Async<int> uring_read(int fd, void* buf, uint32_t count,
+                             uint64_t offset = static_cast<uint64_t>(-1)) {
+    int result = 0;
+    bool completed = co_await IOAwaiter<UringRequest>{UringRequest{
+        .op_ = UringOp::READ, .fd_ = fd, .buf_ = buf, .len_ = count, .offset_ = offset,
+        .result_ = &result}};
+    co_return completed ? result : -ECANCELED;
+}
+
+inline Async<int> uring_write(int fd, const void* buf, uint32_t count,
+                              uint64_t offset = static_cast<uint64_t>(-1)) {
+    int result = 0;
+    bool completed = co_await IOAwaiter<UringRequest>{UringRequest{
+        .op_ = UringOp::WRITE, .fd_ = fd, .buf_ = const_cast<void*>(buf), .len_ = count,
+        .offset_ = offset, .result_ = &result}};
+    co_return completed ? result : -ECANCELED;
+}
+
+// the accepted socket is close-on-exec
+inline Async<int> uring_accept(int fd, sockaddr* addr = nullptr,
+                               socklen_t* addrlen = nullptr) {
+    int result = 0;
+    bool completed = co_await IOAwaiter<UringRequest>{UringRequest{
+        .op_ = UringOp::ACCEPT, .fd_ = fd, .addr_ = addr, .addrlen_ = addrlen,
+        .result_ = &result}};
+    co_return completed ? result : -ECANCELED;
+}
+
+// returns 0 once the duration has elapsed
+template <class Rep, class Period>
+Async<int> uring_timeout(std::chrono::duration<Rep, Period> duration) {
+    int result = 0;
+    bool completed = co_await IOAwaiter<UringRequest>{UringRequest{
+        .op_ = UringOp::TIMEOUT,
+        .timeout_ = std::chrono::duration_cast<std::chrono::nanoseconds>(duration),
+        .result_ = &result}};
+    if (!completed) {
+        co_return -ECANCELED;
+    }
+    co_return result == -ETIME ? 0 : result;
+}
+
+}  // namespace shcoro
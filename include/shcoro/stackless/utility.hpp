@@ -1,5 +1,11 @@
 #pragma once
 
+#include <ranges>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
 #include "async.hpp"
 #include "awaiter_concepts.hpp"
 #include "mux.hpp"
@@ -50,4 +56,47 @@ Mux<any_of_return_t<awaiter_return_t<T>...>> any_of(T... tasks) {
     co_return co_await AnyOfAwaiter(make_mux_adapter(std::move(tasks), scheduler)...);
 }
 
+namespace detail {
+
+// an rvalue vector is taken as is, other ranges have their tasks moved out
+template <std::ranges::input_range R>
+auto take_tasks(R&& tasks) {
+    using TaskT = std::ranges::range_value_t<R>;
+    if constexpr (std::is_same_v<R, std::vector<TaskT>>) {
+        return std::move(tasks);
+    } else {
+        std::vector<TaskT> ret;
+        if constexpr (std::ranges::sized_range<R>) {
+            ret.reserve(std::ranges::size(tasks));
+        }
+        for (auto&& task : tasks) {
+            ret.push_back(std::move(task));
+        }
+        return ret;
+    }
+}
+
+}  // namespace detail
+
+// co_await when_all(std::move(tasks)) returns a std::vector of the results in order
+template <std::ranges::input_range R>
+    requires ContinuationAwaiterConcept<std::ranges::range_value_t<R>>
+auto when_all(R&& tasks) {
+    using TaskT = std::ranges::range_value_t<R>;
+    return WhenAllAwaiter<TaskT>(detail::take_tasks(std::forward<R>(tasks)));
+}
+
+// co_await when_any(std::move(tasks)) returns the index and the result of the first task
+// to finish, tasks must not be empty
+template <std::ranges::input_range R>
+    requires ContinuationAwaiterConcept<std::ranges::range_value_t<R>>
+auto when_any(R&& tasks) {
+    using TaskT = std::ranges::range_value_t<R>;
+    auto taken = detail::take_tasks(std::forward<R>(tasks));
+    if (taken.empty()) {
+        detail::throw_exception(std::invalid_argument("when_any of no tasks"));
+    }
+    return WhenAnyAwaiter<TaskT>(std::move(taken));
+}
+
 }  // namespace shcoro
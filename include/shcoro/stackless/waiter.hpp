@@ -0,0 +1,182 @@
+#pragma once
+
+#include <coroutine>
+#include <utility>
+
+#include "promise_concepts.hpp"
+#include "scheduler.hpp"
+#include "scheduler_node.hpp"
+#include "shcoro/utils/noncopyable.h"
+
+namespace shcoro {
+
+// How a lock hands over to a suspended waiter
+enum class WakeupPolicy {
+    INLINE,      // resume the waiter on the releasing thread
+    RESCHEDULE,  // register the waiter into its own scheduler, resume inline without one
+};
+
+// A coroutine suspended on a synchronization primitive, embedded in its awaiter.
+// RESCHEDULE needs a scheduler accepting registrations without a value, that is also safe
+// to call from the releasing thread.
+// A primitive whose waits can be cancelled arms watch_cancellation() with a function that
+// takes the waiter out of its queue and, if it was still there, calls cancel(). When it
+// finds cancellation requested, the wait ends with yield_cancelled() outside of the lock
+// of the primitive, so that a coroutine retrying in a loop is abandoned by its race or
+// still gives up the thread.
+struct Waiter {
+    template <typename PromiseType>
+    void set_waiter(std::coroutine_handle<PromiseType> caller) noexcept {
+        handle_ = caller;
+        if constexpr (PromiseSchedulerNodeConcept<PromiseType>) {
+            scheduler_ = caller.promise().get_scheduler();
+            node_ = &caller.promise().get_scheduler_node();
+        } else if constexpr (PromiseSchedulerConcept<PromiseType>) {
+            scheduler_ = caller.promise().get_scheduler();
+        }
+        if constexpr (PromiseCancellationConcept<PromiseType>) {
+            token_ = caller.promise().get_cancellation_token();
+        }
+    }
+
+    // false if cancellation of the waiting coroutine was requested already, arms
+    // on_cancel(context) on its token otherwise
+    bool watch_cancellation(CancellationCallback::callback_type on_cancel,
+                            void* context) noexcept {
+        if (!cancel_cb_.arm(token_, on_cancel, context)) {
+            cancelled_ = true;
+            return false;
+        }
+        return true;
+    }
+
+    // leaves the waiter suspended if its race abandons it (see CancellationToken), or
+    // else registers it into its own scheduler to resume as cancelled. false if there is
+    // none taking registrations without a value, the wait returns right away then.
+    bool yield_cancelled() noexcept {
+        if (token_.abandon()) {
+            return true;
+        }
+        if (!scheduler_.can_yield()) {
+            return false;
+        }
+        reschedule(handle_, scheduler_, node_);
+        return true;
+    }
+
+    // resumes the waiter that was taken out of its queue, inline whatever the policy
+    void cancel() {
+        cancelled_ = true;
+        handle_.resume();
+    }
+
+    // the waiter may be destroyed as soon as its coroutine runs, so nothing is read after
+    void wake(WakeupPolicy policy) {
+        cancel_cb_.reset();
+        auto handle = handle_;
+        auto sched = scheduler_;
+        if (policy == WakeupPolicy::RESCHEDULE && sched) {
+            reschedule(handle, sched, node_);
+        } else {
+            handle.resume();
+        }
+    }
+
+    static void reschedule(std::coroutine_handle<> handle, Scheduler& sched,
+                           SchedulerNode* node) {
+        if (node) {
+            node->handle_ = handle;
+            scheduler_register_node(sched, *node);
+        } else {
+            scheduler_register_coro(sched, handle);
+        }
+    }
+
+    std::coroutine_handle<> handle_{nullptr};
+    Scheduler scheduler_;
+    SchedulerNode* node_{nullptr};
+    CancellationToken token_;
+    CancellationCallback cancel_cb_;
+    bool cancelled_{false};
+};
+
+// FIFO of waiters linked through NodeT::next_. Nodes live in the awaiters, i.e. in the
+// suspended coroutine frames, so queueing never allocates.
+template <typename NodeT>
+class WaiterQueue {
+   public:
+    bool empty() const noexcept { return head_ == nullptr; }
+
+    NodeT& front() noexcept { return *head_; }
+    NodeT* head() const noexcept { return head_; }
+
+    void push(NodeT& node) noexcept {
+        node.next_ = nullptr;
+        if (tail_) {
+            tail_->next_ = &node;
+        } else {
+            head_ = &node;
+        }
+        tail_ = &node;
+    }
+
+    NodeT& pop() noexcept {
+        auto* node = head_;
+        head_ = node->next_;
+        if (head_ == nullptr) {
+            tail_ = nullptr;
+        }
+        return *node;
+    }
+
+    // false if node is not queued, walks the queue
+    bool remove(NodeT& node) noexcept {
+        NodeT* prev = nullptr;
+        for (auto* it = head_; it; prev = it, it = it->next_) {
+            if (it != &node) {
+                continue;
+            }
+            if (prev) {
+                prev->next_ = it->next_;
+            } else {
+                head_ = it->next_;
+            }
+            if (tail_ == it) {
+                tail_ = prev;
+            }
+            return true;
+        }
+        return false;
+    }
+
+   private:
+    NodeT* head_{nullptr};
+    NodeT* tail_{nullptr};
+};
+
+// Holds a coroutine lock taken with co_await lock.scoped_lock() and releases it when
+// destroyed, so an early co_return can not leak the lock
+template <typename LockT, void (LockT::*Unlock)()>
+class [[nodiscard]] ScopedLockGuard : noncopyable {
+   public:
+    // owns nothing, e.g. when the wait for the lock was cancelled
+    ScopedLockGuard() noexcept : lock_(nullptr) {}
+    explicit ScopedLockGuard(LockT& lock) noexcept : lock_(&lock) {}
+    ScopedLockGuard(ScopedLockGuard&& other) noexcept
+        : lock_(std::exchange(other.lock_, nullptr)) {}
+    ~ScopedLockGuard() { unlock(); }
+
+    void unlock() {
+        if (lock_) {
+            (std::exchange(lock_, nullptr)->*Unlock)();
+        }
+    }
+
+    bool owns_lock() const noexcept { return lock_ != nullptr; }
+    explicit operator bool() const noexcept { return owns_lock(); }
+
+   private:
+    LockT* lock_;
+};
+
+}  // namespace shcoro
@@ -0,0 +1,298 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "promise_concepts.hpp"
+#include "shcoro/stackless/scheduler_awaiter.hpp"
+#include "shcoro/utils/chase_lev_deque.h"
+#include "shcoro/utils/logger.h"
+#include "shcoro/utils/noncopyable.h"
+
+namespace shcoro {
+// Thread pool scheduler. Every worker owns a Chase-Lev deque, coroutines registered
+// by a worker go to its own deque and idle workers steal from the others.
+// Coroutines registered from outside the pool go through a shared injection queue,
+// which a worker also checks first on every inject_interval-th pop, so coroutines
+// yielding on its own deque can not starve it.
+// Entries can not be taken out of a deque, so a withdrawn SchedulerNode is recorded and
+// the worker popping it skips it. The node's key_ holds its queue state. A worker
+// inspecting a node publishes it as its hazard pointer; a withdrawing thread that finds
+// the node there never waits for the worker, it leaves the entry to it instead (see
+// unregister_node), so that the node may be destroyed as soon as unregister_node returns
+// true.
+class WorkStealingScheduler : noncopyable {
+   public:
+    explicit WorkStealingScheduler(size_t worker_num = std::thread::hardware_concurrency())
+        : worker_num_(worker_num ? worker_num : 1) {
+        for (size_t i = 0; i < worker_num_; i++) {
+            workers_.push_back(std::make_unique<Worker>());
+        }
+    }
+
+    void register_coro(std::coroutine_handle<> coro) {
+        SHCORO_LOG("work stealing register: ", coro.address());
+        push(reinterpret_cast<uintptr_t>(coro.address()) | foreign_tag);
+    }
+
+    void register_node(SchedulerNode& node) {
+        SHCORO_LOG("work stealing register node: ", node.handle_.address());
+        // released so that a withdrawing thread, which may resume and destroy the
+        // coroutine, sees everything the registering one did before
+        std::atomic_ref<uint64_t>(node.key_).store(queued, std::memory_order_release);
+        push(reinterpret_cast<uintptr_t>(&node));
+    }
+
+    // Coroutines registered without a node can not be withdrawn, they must not be
+    // destroyed while registered.
+    bool unregister_coro(std::coroutine_handle<>) { return false; }
+
+    // true if node was queued, it will not be resumed then. false if it was not queued,
+    // or if a worker is claiming its entry right now: it resumes the coroutine then.
+    bool unregister_node(SchedulerNode& node) {
+        std::atomic_ref<uint64_t> state(node.key_);
+        uint64_t expected = queued;
+        if (state.load(std::memory_order_acquire) != queued ||
+            !state.compare_exchange_strong(expected, withdrawn,
+                                           std::memory_order_acq_rel)) {
+            return false;
+        }
+        SHCORO_LOG("work stealing withdraw node: ", node.handle_.address());
+        {
+            std::lock_guard<std::mutex> guard(withdrawn_mutex_);
+            withdrawn_.insert(&node);
+            withdrawn_num_.fetch_add(1, std::memory_order_seq_cst);
+        }
+        for (auto& worker : workers_) {
+            if (worker->hazard_.load(std::memory_order_seq_cst) == &node) {
+                return leave_to_worker(node);
+            }
+        }
+        // a worker publishing the node from now on finds the record and skips it
+        if (state.load(std::memory_order_acquire) == consumed) {
+            // a worker popped the entry before the record was made
+            take_withdrawn(&node);
+        }
+        state.store(idle, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Runs worker_number() workers (the calling thread included) until no
+    // coroutine is pending.
+    void run() {
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < worker_num_; i++) {
+            threads.emplace_back([this, i] { work(i); });
+        }
+        work(0);
+        for (auto& t : threads) {
+            t.join();
+        }
+    }
+
+    size_t pending_number() const { return pending_.load(std::memory_order_acquire); }
+    size_t worker_number() const { return worker_num_; }
+
+   private:
+    // queue entries are SchedulerNode pointers, or coroutine addresses tagged with
+    // foreign_tag for coroutines registered without a node
+    static constexpr uintptr_t foreign_tag = 1;
+
+    // node.key_ states
+    static constexpr uint64_t idle = 0;
+    static constexpr uint64_t queued = 1;
+    static constexpr uint64_t withdrawn = 2;
+    static constexpr uint64_t consumed = 3;  // withdrawn and its entry already popped
+
+    // as Go's scheduler, a prime so that it does not line up with periodic workloads
+    static constexpr uint32_t inject_interval = 61;
+
+    struct Worker {
+        ChaseLevDeque<uintptr_t> deque_;
+        uint32_t ticks_{0};  // only touched by the owner
+        // the node this worker is inspecting
+        std::atomic<SchedulerNode*> hazard_{nullptr};
+    };
+
+    struct WorkerContext {
+        WorkStealingScheduler* sched_{nullptr};
+        size_t index_{0};
+    };
+
+    void work(size_t index) {
+        current() = WorkerContext{this, index};
+        while (pending_.load(std::memory_order_acquire) != 0) {
+            auto epoch = epoch_.load(std::memory_order_acquire);
+            if (auto entry = find_work(index)) {
+                if (auto handle = claim(index, entry)) {
+                    SHCORO_LOG("worker ", index, " resume handle: ", handle.address());
+                    handle.resume();
+                }
+                if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    wake_all();
+                }
+                continue;
+            }
+            if (pending_.load(std::memory_order_acquire) == 0) {
+                break;
+            }
+            // nothing to run, sleep until a coroutine is registered
+            sleepers_.fetch_add(1, std::memory_order_seq_cst);
+            epoch_.wait(epoch, std::memory_order_acquire);
+            sleepers_.fetch_sub(1, std::memory_order_relaxed);
+        }
+        current() = WorkerContext{};
+    }
+
+    void push(uintptr_t entry) {
+        pending_.fetch_add(1, std::memory_order_relaxed);
+        if (current().sched_ == this) {
+            workers_[current().index_]->deque_.push(entry);
+        } else {
+            std::lock_guard<std::mutex> guard(inject_mutex_);
+            inject_queue_.push_back(entry);
+        }
+        wake_one();
+    }
+
+    uintptr_t find_work(size_t index) {
+        auto& worker = *workers_[index];
+        if (++worker.ticks_ % inject_interval == 0) {
+            if (auto entry = pop_injected()) {
+                return entry;
+            }
+        }
+        // the owner also takes from the top so that yielding coroutines keep FIFO order
+        if (auto entry = worker.deque_.steal()) {
+            return *entry;
+        }
+        if (auto entry = pop_injected()) {
+            return entry;
+        }
+        for (size_t i = 1; i < worker_num_; i++) {
+            if (auto entry = workers_[(index + i) % worker_num_]->deque_.steal()) {
+                return *entry;
+            }
+        }
+        return 0;
+    }
+
+    uintptr_t pop_injected() {
+        std::lock_guard<std::mutex> guard(inject_mutex_);
+        if (inject_queue_.empty()) {
+            return 0;
+        }
+        auto entry = inject_queue_.front();
+        inject_queue_.pop_front();
+        return entry;
+    }
+
+    // the coroutine to resume for entry, nullptr if it was withdrawn
+    std::coroutine_handle<> claim(size_t index, uintptr_t entry) {
+        if (entry & foreign_tag) {
+            return std::coroutine_handle<>::from_address(
+                reinterpret_cast<void*>(entry & ~foreign_tag));
+        }
+        auto* node = reinterpret_cast<SchedulerNode*>(entry);
+        auto& hazard = workers_[index]->hazard_;
+        hazard.store(node, std::memory_order_seq_cst);
+        if (withdrawn_num_.load(std::memory_order_seq_cst) != 0 && take_withdrawn(node)) {
+            // the node may be gone already
+            hazard.store(nullptr, std::memory_order_release);
+            return nullptr;
+        }
+        // not recorded, a concurrent withdrawer sees the hazard and leaves the node alive
+        // until this entry is resolved, see leave_to_worker
+        std::atomic_ref<uint64_t> state(node->key_);
+        uint64_t expected = queued;
+        std::coroutine_handle<> handle = nullptr;
+        while (true) {
+            if (state.compare_exchange_strong(expected, idle, std::memory_order_acq_rel)) {
+                handle = node->handle_;
+                break;
+            }
+            // withdrawn meanwhile: the entry is used up, unless the withdrawal is undone
+            if (expected != withdrawn ||
+                state.compare_exchange_strong(expected, consumed,
+                                              std::memory_order_acq_rel)) {
+                break;
+            }
+            // undone, queued again
+        }
+        hazard.store(nullptr, std::memory_order_release);
+        return handle;
+    }
+
+    // unregister_node found a worker inspecting node after recording the withdrawal.
+    // Instead of waiting for it, the withdrawal is undone if the worker may still claim
+    // the entry, the worker then resumes the coroutine. Nothing here waits.
+    bool leave_to_worker(SchedulerNode& node) {
+        std::atomic_ref<uint64_t> state(node.key_);
+        if (!take_withdrawn(&node)) {
+            // the worker found the record and skipped the entry without touching node
+            state.store(idle, std::memory_order_relaxed);
+            return true;
+        }
+        uint64_t expected = withdrawn;
+        if (state.compare_exchange_strong(expected, queued, std::memory_order_acq_rel)) {
+            SHCORO_LOG("work stealing withdraw undone: ", node.handle_.address());
+            return false;
+        }
+        // the worker already marked the entry consumed and leaves node alone
+        state.store(idle, std::memory_order_relaxed);
+        return true;
+    }
+
+    bool take_withdrawn(SchedulerNode* node) {
+        std::lock_guard<std::mutex> guard(withdrawn_mutex_);
+        auto it = withdrawn_.find(node);
+        if (it == withdrawn_.end()) {
+            return false;
+        }
+        withdrawn_.erase(it);
+        withdrawn_num_.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    void wake_one() {
+        epoch_.fetch_add(1, std::memory_order_seq_cst);
+        if (sleepers_.load(std::memory_order_seq_cst) != 0) {
+            epoch_.notify_one();
+        }
+    }
+
+    void wake_all() {
+        epoch_.fetch_add(1, std::memory_order_seq_cst);
+        epoch_.notify_all();
+    }
+
+    static WorkerContext& current() noexcept {
+        static thread_local WorkerContext context;
+        return context;
+    }
+
+    size_t worker_num_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+
+    std::mutex inject_mutex_;
+    std::deque<uintptr_t> inject_queue_;
+
+    // a node withdrawn and re-registered before its old entry was popped is recorded
+    // once per stale entry
+    std::mutex withdrawn_mutex_;
+    std::unordered_multiset<SchedulerNode*> withdrawn_;
+    std::atomic<size_t> withdrawn_num_{0};
+
+    std::atomic<size_t> pending_{0};
+    std::atomic<uint32_t> epoch_{0};
+    std::atomic<size_t> sleepers_{0};
+};
+
+}  // namespace shcoro
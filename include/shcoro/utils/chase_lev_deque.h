@@ -0,0 +1,127 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
+#include "noncopyable.h"
+
+namespace shcoro {
+
+// Lock-free work-stealing deque (Chase & Lev, with the C11 memory orderings from
+// Le et al., "Correct and Efficient Work-Stealing for Weak Memory Models").
+// push() and pop() may only be called by the owner thread, steal() by any thread.
+template <typename T>
+class ChaseLevDeque : noncopyable {
+    static_assert(std::is_trivially_copyable_v<T>, "T must be trivially copyable");
+
+   public:
+    explicit ChaseLevDeque(size_t capacity = 256) {
+        size_t cap = 1;
+        while (cap < capacity) cap <<= 1;
+        arrays_.push_back(std::make_unique<Array>(cap));
+        array_.store(arrays_.back().get(), std::memory_order_relaxed);
+    }
+
+    // owner only
+    void push(T value) {
+        int64_t b = bottom_.load(std::memory_order_relaxed);
+        int64_t t = top_.load(std::memory_order_acquire);
+        Array* a = array_.load(std::memory_order_relaxed);
+        if (b - t > static_cast<int64_t>(a->capacity_) - 1) {
+            // old arrays are kept alive until destruction since thieves may still read them
+            arrays_.push_back(a->grow(t, b));
+            a = arrays_.back().get();
+            array_.store(a, std::memory_order_release);
+        }
+        a->put(b, value);
+        // a release store rather than a fence: same ordering, and visible to TSan
+        bottom_.store(b + 1, std::memory_order_release);
+    }
+
+    // owner only, takes from the bottom (LIFO)
+    std::optional<T> pop() {
+        int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+        Array* a = array_.load(std::memory_order_relaxed);
+        bottom_.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top_.load(std::memory_order_relaxed);
+
+        if (t > b) {
+            bottom_.store(b + 1, std::memory_order_relaxed);
+            return std::nullopt;
+        }
+
+        T value = a->get(b);
+        if (t == b) {
+            // last element, race against thieves
+            bool won = top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                                    std::memory_order_relaxed);
+            bottom_.store(b + 1, std::memory_order_relaxed);
+            if (!won) return std::nullopt;
+        }
+        return value;
+    }
+
+    // any thread, takes from the top (FIFO)
+    std::optional<T> steal() {
+        int64_t t = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom_.load(std::memory_order_acquire);
+
+        if (t >= b) {
+            return std::nullopt;
+        }
+
+        Array* a = array_.load(std::memory_order_acquire);
+        T value = a->get(t);
+        if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                          std::memory_order_relaxed)) {
+            return std::nullopt;
+        }
+        return value;
+    }
+
+    bool empty() const noexcept { return size() == 0; }
+
+    size_t size() const noexcept {
+        int64_t b = bottom_.load(std::memory_order_relaxed);
+        int64_t t = top_.load(std::memory_order_relaxed);
+        return b > t ? static_cast<size_t>(b - t) : 0;
+    }
+
+   private:
+    struct Array {
+        explicit Array(size_t capacity)
+            : capacity_(capacity), buffer_(new std::atomic<T>[capacity]) {}
+
+        T get(int64_t i) const noexcept {
+            return buffer_[i & (capacity_ - 1)].load(std::memory_order_relaxed);
+        }
+        void put(int64_t i, T value) noexcept {
+            buffer_[i & (capacity_ - 1)].store(value, std::memory_order_relaxed);
+        }
+
+        std::unique_ptr<Array> grow(int64_t top, int64_t bottom) const {
+            auto bigger = std::make_unique<Array>(capacity_ * 2);
+            for (int64_t i = top; i < bottom; i++) {
+                bigger->put(i, get(i));
+            }
+            return bigger;
+        }
+
+        size_t capacity_;
+        std::unique_ptr<std::atomic<T>[]> buffer_;
+    };
+
+    alignas(64) std::atomic<int64_t> top_{0};
+    alignas(64) std::atomic<int64_t> bottom_{0};
+    std::atomic<Array*> array_{nullptr};
+    std::vector<std::unique_ptr<Array>> arrays_;
+};
+
+}  // namespace shcoro
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
+
+// SHCORO_NO_EXCEPTIONS (or building with -fno-exceptions) compiles the exception
+// plumbing out of the library
+#if defined(SHCORO_NO_EXCEPTIONS) || !defined(__cpp_exceptions)
+#define SHCORO_EXCEPTIONS 0
+#else
+#define SHCORO_EXCEPTIONS 1
+#endif
+
+namespace shcoro::detail {
+
+// throws e, or reports it and aborts when exceptions are disabled
+template <typename E>
+[[noreturn]] void throw_exception(E&& e) {
+#if SHCORO_EXCEPTIONS
+    throw std::forward<E>(e);
+#else
+    std::fprintf(stderr, "shcoro: %s\n", e.what());
+    std::abort();
+#endif
+}
+
+}  // namespace shcoro::detail
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+#include "exception.h"
+
+namespace shcoro {
+
+// Minimal stand-in for the C++23 std::expected, which is not available in C++20
+
+template <typename E>
+class unexpected {
+   public:
+    explicit unexpected(E error) : error_(std::move(error)) {}
+
+    E& error() & noexcept { return error_; }
+    const E& error() const& noexcept { return error_; }
+    E&& error() && noexcept { return std::move(error_); }
+
+   private:
+    E error_;
+};
+
+template <typename E>
+unexpected(E) -> unexpected<E>;
+
+// thrown by value() on an error, aborts without exceptions
+struct bad_expected_access : std::exception {
+    const char* what() const noexcept override { return "bad expected access"; }
+};
+
+// Holds either a T or an E
+template <typename T, typename E>
+class expected {
+   public:
+    using value_type = T;
+    using error_type = E;
+
+    expected()
+        requires std::is_default_constructible_v<T>
+        : storage_(std::in_place_index<0>) {}
+    expected(const T& value) : storage_(std::in_place_index<0>, value) {}
+    expected(T&& value) : storage_(std::in_place_index<0>, std::move(value)) {}
+    expected(unexpected<E> error)
+        : storage_(std::in_place_index<1>, std::move(error).error()) {}
+
+    bool has_value() const noexcept { return storage_.index() == 0; }
+    explicit operator bool() const noexcept { return has_value(); }
+
+    T& value() & {
+        check();
+        return std::get<0>(storage_);
+    }
+    const T& value() const& {
+        check();
+        return std::get<0>(storage_);
+    }
+    T&& value() && {
+        check();
+        return std::get<0>(std::move(storage_));
+    }
+
+    template <typename U>
+    T value_or(U&& fallback) const& {
+        return has_value() ? std::get<0>(storage_)
+                           : static_cast<T>(std::forward<U>(fallback));
+    }
+
+    // unchecked
+    T& operator*() & noexcept { return *std::get_if<0>(&storage_); }
+    const T& operator*() const& noexcept { return *std::get_if<0>(&storage_); }
+    T&& operator*() && noexcept { return std::move(*std::get_if<0>(&storage_)); }
+    T* operator->() noexcept { return std::get_if<0>(&storage_); }
+    const T* operator->() const noexcept { return std::get_if<0>(&storage_); }
+
+    E& error() & noexcept { return *std::get_if<1>(&storage_); }
+    const E& error() const& noexcept { return *std::get_if<1>(&storage_); }
+
+   private:
+    void check() const {
+        if (!has_value()) [[unlikely]] {
+            detail::throw_exception(bad_expected_access{});
+        }
+    }
+
+    std::variant<T, E> storage_;
+};
+
+template <typename E>
+class expected<void, E> {
+   public:
+    using value_type = void;
+    using error_type = E;
+
+    expected() noexcept = default;
+    expected(unexpected<E> error) : error_(std::move(error).error()) {}
+
+    bool has_value() const noexcept { return !error_.has_value(); }
+    explicit operator bool() const noexcept { return has_value(); }
+
+    void value() const {
+        if (!has_value()) [[unlikely]] {
+            detail::throw_exception(bad_expected_access{});
+        }
+    }
+    void operator*() const noexcept {}
+
+    E& error() & noexcept { return *error_; }
+    const E& error() const& noexcept { return *error_; }
+
+   private:
+    std::optional<E> error_;
+};
+
+}  // namespace shcoro
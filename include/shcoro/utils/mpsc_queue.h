@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+
+#include "noncopyable.h"
+
+namespace shcoro {
+
+struct MPSCNode {
+    std::atomic<MPSCNode*> next_{nullptr};
+};
+
+// Intrusive lock-free multi-producer single-consumer queue (Vyukov).
+// push() may be called by any thread, pop() and empty() only by the consumer.
+// A push is wait-free, a pop may miss a node whose push is still in progress.
+class MPSCQueue : noncopyable {
+   public:
+    MPSCQueue() noexcept : head_(&stub_), tail_(&stub_) {}
+
+    void push(MPSCNode* node) noexcept {
+        node->next_.store(nullptr, std::memory_order_relaxed);
+        MPSCNode* prev = head_.exchange(node, std::memory_order_acq_rel);
+        prev->next_.store(node, std::memory_order_release);
+    }
+
+    MPSCNode* pop() noexcept {
+        MPSCNode* tail = tail_;
+        MPSCNode* next = tail->next_.load(std::memory_order_acquire);
+        if (tail == &stub_) {
+            if (next == nullptr) {
+                return nullptr;
+            }
+            tail_ = next;
+            tail = next;
+            next = next->next_.load(std::memory_order_acquire);
+        }
+        if (next != nullptr) {
+            tail_ = next;
+            return tail;
+        }
+        if (tail != head_.load(std::memory_order_acquire)) {
+            // a producer is between the exchange and the link
+            return nullptr;
+        }
+        // tail is the last node, put the stub behind it so it can be handed out
+        push(&stub_);
+        next = tail->next_.load(std::memory_order_acquire);
+        if (next != nullptr) {
+            tail_ = next;
+            return tail;
+        }
+        return nullptr;
+    }
+
+    bool empty() const noexcept {
+        return tail_ == &stub_ && stub_.next_.load(std::memory_order_acquire) == nullptr;
+    }
+
+   private:
+    alignas(64) std::atomic<MPSCNode*> head_;
+    alignas(64) MPSCNode* tail_;
+    MPSCNode stub_;
+};
+
+}  // namespace shcoro
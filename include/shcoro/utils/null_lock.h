@@ -0,0 +1,12 @@
+#pragma once
+
+namespace shcoro {
+
+// BasicLockable that does nothing, for primitives used from a single thread
+struct NullLock {
+    void lock() noexcept {}
+    bool try_lock() noexcept { return true; }
+    void unlock() noexcept {}
+};
+
+}  // namespace shcoro
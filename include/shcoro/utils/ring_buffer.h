@@ -0,0 +1,84 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "noncopyable.h"
+
+namespace shcoro {
+
+inline constexpr size_t dynamic_capacity = ~size_t{0};
+
+// Fixed capacity FIFO of T constructed in place. The capacity is a template argument, or
+// given to the constructor with Capacity = dynamic_capacity (one allocation up front).
+// push() on a full and pop() on an empty buffer are undefined.
+template <typename T, size_t Capacity = dynamic_capacity>
+class RingBuffer : noncopyable {
+    struct Slot {
+        alignas(T) unsigned char bytes_[sizeof(T)];
+    };
+    static constexpr bool is_dynamic = Capacity == dynamic_capacity;
+    using Storage = std::conditional_t<is_dynamic, std::unique_ptr<Slot[]>,
+                                       std::array<Slot, is_dynamic ? 0 : Capacity>>;
+
+   public:
+    RingBuffer() noexcept
+        requires(!is_dynamic)
+    = default;
+
+    explicit RingBuffer(size_t capacity)
+        requires is_dynamic
+        : slots_(std::make_unique_for_overwrite<Slot[]>(capacity)), capacity_(capacity) {}
+
+    ~RingBuffer() {
+        while (!empty()) {
+            pop();
+        }
+    }
+
+    size_t capacity() const noexcept {
+        if constexpr (is_dynamic) {
+            return capacity_;
+        } else {
+            return Capacity;
+        }
+    }
+    size_t size() const noexcept { return size_; }
+    bool empty() const noexcept { return size_ == 0; }
+    bool full() const noexcept { return size_ == capacity(); }
+
+    template <typename... Args>
+    void push(Args&&... args) {
+        size_t index = head_ + size_;
+        if (index >= capacity()) {
+            index -= capacity();
+        }
+        ::new (slot(index)) T(std::forward<Args>(args)...);
+        size_++;
+    }
+
+    T pop() {
+        T* item = std::launder(reinterpret_cast<T*>(slot(head_)));
+        T value(std::move(*item));
+        item->~T();
+        if (++head_ == capacity()) {
+            head_ = 0;
+        }
+        size_--;
+        return value;
+    }
+
+   private:
+    void* slot(size_t index) noexcept { return slots_[index].bytes_; }
+
+    Storage slots_{};
+    size_t capacity_{Capacity};
+    size_t head_{0};
+    size_t size_{0};
+};
+
+}  // namespace shcoro
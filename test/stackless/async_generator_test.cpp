@@ -0,0 +1,89 @@
+#include "shcoro/stackless/async_generator.hpp"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "shcoro/stackless/fifo_scheduler.hpp"
+#include "shcoro/stackless/timer.hpp"
+#include "shcoro/stackless/utility.hpp"
+
+using namespace std::chrono_literals;
+
+TEST(AsyncGeneratorTest, YieldsInOrderThenEnds) {
+    auto gen = []() -> shcoro::AsyncGenerator<std::string> {
+        for (int i = 0; i < 3; i++) {
+            co_yield std::to_string(i);
+        }
+    };
+    auto consumer = [&]() -> shcoro::Async<std::vector<std::string>> {
+        std::vector<std::string> values;
+        auto g = gen();
+        while (auto value = co_await g.next()) {
+            values.push_back(std::move(*value));
+        }
+        // awaiting a finished generator is harmless
+        EXPECT_FALSE(co_await g.next());
+        co_return values;
+    };
+
+    EXPECT_EQ(shcoro::spawn_async(consumer()).get(),
+              (std::vector<std::string>{"0", "1", "2"}));
+}
+
+TEST(AsyncGeneratorTest, BodyAwaitsOnCallerScheduler) {
+    shcoro::TimedScheduler sched;
+    std::vector<std::string> trace;
+
+    auto pages = [&]() -> shcoro::AsyncGenerator<int> {
+        for (int page = 0; page < 3; page++) {
+            // waits on the timers of the consumer's scheduler
+            co_await shcoro::TimedAwaiter{5ms};
+            trace.push_back("fetched " + std::to_string(page));
+            co_yield page;
+        }
+    };
+    auto consumer = [&]() -> shcoro::Async<void> {
+        auto g = pages();
+        while (auto page = co_await g.next()) {
+            trace.push_back("consumed " + std::to_string(*page));
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    auto r = shcoro::spawn_async(consumer(), sched);
+    EXPECT_TRUE(trace.empty());
+    sched.run();
+
+    EXPECT_GE(std::chrono::steady_clock::now() - start, 15ms);
+    EXPECT_EQ(trace, (std::vector<std::string>{"fetched 0", "consumed 0", "fetched 1",
+                                               "consumed 1", "fetched 2", "consumed 2"}));
+}
+
+TEST(AsyncGeneratorTest, NestedAsyncInBody) {
+    shcoro::IntrusiveFIFOScheduler sched;
+
+    auto square = [](int v) -> shcoro::Async<int> {
+        co_await shcoro::FIFOAwaiter{};
+        co_return v * v;
+    };
+    auto gen = [&]() -> shcoro::AsyncGenerator<int> {
+        for (int i = 1; i <= 3; i++) {
+            co_yield co_await square(i);
+        }
+    };
+    auto consumer = [&]() -> shcoro::Async<int> {
+        int sum = 0;
+        auto g = gen();
+        while (auto value = co_await g.next()) {
+            sum += *value;
+        }
+        co_return sum;
+    };
+
+    auto r = shcoro::spawn_async(consumer(), sched);
+    sched.run();
+    EXPECT_EQ(r.get(), 14);
+}
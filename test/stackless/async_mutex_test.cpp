@@ -0,0 +1,172 @@
+#include "shcoro/stackless/async_mutex.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "shcoro/stackless/fifo_scheduler.hpp"
+#include "shcoro/stackless/utility.hpp"
+#include "shcoro/stackless/work_stealing_scheduler.hpp"
+
+namespace {
+
+void check_mutual_exclusion(shcoro::WakeupPolicy policy) {
+    shcoro::WorkStealingScheduler pool(4);
+    shcoro::AsyncMutex mutex(policy);
+    int counter = 0;  // only touched under the mutex
+    std::atomic<int> inside{0};
+    std::atomic<int> overlaps{0};
+
+    auto task = [&]() -> shcoro::Async<void> {
+        for (int i = 0; i < 50; i++) {
+            co_await mutex.lock();
+            if (inside.fetch_add(1) != 0) overlaps++;
+            int value = counter;
+            // give other workers a chance to run while the lock is held
+            co_await shcoro::FIFOAwaiter{};
+            counter = value + 1;
+            inside.fetch_sub(1);
+            mutex.unlock();
+        }
+    };
+
+    std::vector<shcoro::AsyncRO<void>> results;
+    for (int i = 0; i < 32; i++) {
+        results.push_back(shcoro::spawn_async(task(), pool));
+    }
+    pool.run();
+
+    EXPECT_EQ(counter, 32 * 50);
+    EXPECT_EQ(overlaps, 0);
+    EXPECT_TRUE(mutex.try_lock());
+}
+
+}  // namespace
+
+TEST(AsyncMutexTest, InlineWakeupAcrossThreads) {
+    check_mutual_exclusion(shcoro::WakeupPolicy::INLINE);
+}
+
+TEST(AsyncMutexTest, RescheduledWakeupAcrossThreads) {
+    check_mutual_exclusion(shcoro::WakeupPolicy::RESCHEDULE);
+}
+
+TEST(AsyncMutexTest, FifoHandOver) {
+    shcoro::IntrusiveFIFOScheduler sched;
+    shcoro::AsyncMutex mutex;
+    std::vector<int> order;
+
+    ASSERT_TRUE(mutex.try_lock());
+    auto task = [&](int id) -> shcoro::Async<void> {
+        co_await mutex.lock();
+        order.push_back(id);
+        mutex.unlock();
+    };
+
+    auto r1 = shcoro::spawn_async(task(1), sched);
+    auto r2 = shcoro::spawn_async(task(2), sched);
+    auto r3 = shcoro::spawn_async(task(3), sched);
+    EXPECT_TRUE(order.empty());
+    EXPECT_FALSE(mutex.try_lock());
+
+    mutex.unlock();
+    EXPECT_EQ(order, (std::vector<int>{1, 2, 3}));
+    EXPECT_TRUE(mutex.try_lock());
+}
+
+TEST(AsyncMutexTest, RescheduleOnWaiterScheduler) {
+    shcoro::IntrusiveFIFOScheduler sched;
+    shcoro::AsyncMutex mutex(shcoro::WakeupPolicy::RESCHEDULE);
+    bool acquired = false;
+
+    ASSERT_TRUE(mutex.try_lock());
+    auto task = [&]() -> shcoro::Async<void> {
+        auto guard = co_await mutex.scoped_lock();
+        acquired = true;
+    };
+
+    auto r = shcoro::spawn_async(task(), sched);
+    mutex.unlock();
+    // not resumed inline, but queued into its scheduler
+    EXPECT_FALSE(acquired);
+    EXPECT_EQ(sched.pending_number(), 1);
+    sched.run();
+    EXPECT_TRUE(acquired);
+}
+
+TEST(AsyncMutexTest, CancelledWaiterLeavesQueue) {
+    shcoro::AsyncMutex mutex;
+    shcoro::CancellationSource source;
+    std::vector<std::string> trace;
+
+    auto task = [&](std::string name) -> shcoro::Async<void> {
+        auto guard = co_await mutex.scoped_lock();
+        trace.push_back(name + (guard ? " locked" : " cancelled"));
+    };
+
+    ASSERT_TRUE(mutex.try_lock());
+    auto r1 = shcoro::spawn_async(task("a"));
+    auto t = task("b");
+    t.set_cancellation_token(source.token());
+    auto r2 = shcoro::spawn_async(std::move(t));
+    auto r3 = shcoro::spawn_async(task("c"));
+
+    source.request_cancellation();
+    EXPECT_EQ(trace, (std::vector<std::string>{"b cancelled"}));
+    // the ticket b left behind is skipped and freed
+    mutex.unlock();
+    EXPECT_EQ(trace, (std::vector<std::string>{"b cancelled", "a locked", "c locked"}));
+    EXPECT_TRUE(mutex.try_lock());
+}
+
+TEST(AsyncMutexTest, CancelledWaitersAcrossThreads) {
+    shcoro::WorkStealingScheduler pool(4);
+    shcoro::AsyncMutex mutex;
+    shcoro::CancellationSource source;
+    int counter = 0;  // only touched under the mutex
+    std::atomic<int> cancelled{0};
+
+    // the tasks with a token run until they see the cancellation, in a lock wait or
+    // in the yield under the lock
+    auto task = [&](int rounds) -> shcoro::Async<void> {
+        for (int i = 0; i != rounds; i++) {
+            bool locked = co_await mutex.lock();
+            if (!locked) {
+                cancelled++;
+                co_return;
+            }
+            int value = counter;
+            bool resumed = co_await shcoro::FIFOAwaiter{};
+            counter = value + 1;
+            mutex.unlock();
+            if (!resumed) {
+                cancelled++;
+                co_return;
+            }
+        }
+    };
+    auto canceller = [&]() -> shcoro::Async<void> {
+        for (int i = 0; i < 20; i++) {
+            co_await shcoro::FIFOAwaiter{};
+        }
+        source.request_cancellation();
+    };
+
+    std::vector<shcoro::AsyncRO<void>> results;
+    for (int i = 0; i < 32; i++) {
+        auto t = task(i % 2 == 0 ? -1 : 50);
+        if (i % 2 == 0) {
+            t.set_cancellation_token(source.token());
+        }
+        results.push_back(shcoro::spawn_async(std::move(t), pool));
+    }
+    results.push_back(shcoro::spawn_async(canceller(), pool));
+    pool.run();
+
+    EXPECT_EQ(cancelled.load(), 16);
+    // the 16 tasks without a token took the lock 50 times each
+    EXPECT_GE(counter, 16 * 50);
+    EXPECT_TRUE(mutex.try_lock());
+}
@@ -0,0 +1,518 @@
+#include "shcoro/stackless/cancellation.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <string>
+#include <vector>
+
+#include "shcoro/stackless/async_mutex.hpp"
+#include "shcoro/stackless/channel.hpp"
+#include "shcoro/stackless/fifo_scheduler.hpp"
+#include "shcoro/stackless/mutex_lock.hpp"
+#include "shcoro/stackless/rw_lock.hpp"
+#include "shcoro/stackless/semaphore.hpp"
+#include "shcoro/stackless/timer.hpp"
+#include "shcoro/stackless/utility.hpp"
+#include "shcoro/stackless/work_stealing_scheduler.hpp"
+
+using namespace std::chrono_literals;
+
+namespace {
+
+// unregister_coro can not take a registration back
+struct KeepingScheduler {
+    void register_coro(std::coroutine_handle<> coro) { coros_.push_back(coro); }
+    void unregister_coro(std::coroutine_handle<>) {}
+
+    std::vector<std::coroutine_handle<>> coros_;
+};
+
+}  // namespace
+
+TEST(CancellationTest, TimerWaitIsWithdrawn) {
+    shcoro::SteadyTimedScheduler sched;
+    shcoro::CancellationSource source;
+    bool expired = true;
+
+    auto task = [&]() -> shcoro::Async<void> {
+        expired = co_await shcoro::TimedAwaiter{10s};
+    };
+
+    auto t = task();
+    t.set_cancellation_token(source.token());
+    auto r = shcoro::spawn_async(std::move(t), sched);
+    EXPECT_EQ(sched.pending_number(), 1);
+
+    source.request_cancellation();
+    // resumed inline, the scheduler has nothing left to run
+    EXPECT_FALSE(expired);
+    EXPECT_EQ(sched.pending_number(), 0);
+}
+
+TEST(CancellationTest, YieldOnPoolIsWithdrawn) {
+    shcoro::WorkStealingScheduler pool(1);
+    shcoro::CancellationSource source;
+    int yields = 0;
+
+    auto waiter = [&]() -> shcoro::Async<void> {
+        for (;;) {
+            bool resumed = co_await shcoro::FIFOAwaiter{};
+            if (!resumed) {
+                co_return;
+            }
+            yields++;
+        }
+    };
+    auto canceller = [&]() -> shcoro::Async<void> {
+        for (int i = 0; i < 3; i++) {
+            co_await shcoro::FIFOAwaiter{};
+        }
+        source.request_cancellation();
+    };
+
+    // started on the worker, so that both take turns in its own deque
+    std::vector<shcoro::AsyncRO<void>> results;
+    auto start = [&]() -> shcoro::Async<void> {
+        co_await shcoro::FIFOAwaiter{};
+        auto t = waiter();
+        t.set_cancellation_token(source.token());
+        results.push_back(shcoro::spawn_async(std::move(t), pool));
+        results.push_back(shcoro::spawn_async(canceller(), pool));
+        co_return;
+    };
+    auto r = shcoro::spawn_async(start(), pool);
+    pool.run();
+
+    // one yield per canceller yield, then resumed by the canceller only
+    EXPECT_EQ(yields, 3);
+    EXPECT_EQ(pool.pending_number(), 0u);
+}
+
+TEST(CancellationTest, SharedTokenAcrossWorkers) {
+    constexpr int waiter_num = 16;
+
+    for (int round = 0; round < 20; round++) {
+        shcoro::WorkStealingScheduler pool(4);
+        shcoro::CancellationSource source;
+        std::atomic<int> cancelled{0};
+
+        // every yield arms and resets a callback on the shared token
+        auto waiter = [&]() -> shcoro::Async<void> {
+            for (;;) {
+                bool resumed = co_await shcoro::FIFOAwaiter{};
+                if (!resumed) {
+                    cancelled.fetch_add(1, std::memory_order_relaxed);
+                    co_return;
+                }
+            }
+        };
+        auto canceller = [&]() -> shcoro::Async<void> {
+            for (int i = 0; i < 50; i++) {
+                co_await shcoro::FIFOAwaiter{};
+            }
+            source.request_cancellation();
+        };
+
+        std::vector<shcoro::AsyncRO<void>> results;
+        auto start = [&]() -> shcoro::Async<void> {
+            co_await shcoro::FIFOAwaiter{};
+            for (int i = 0; i < waiter_num; i++) {
+                auto t = waiter();
+                t.set_cancellation_token(source.token());
+                results.push_back(shcoro::spawn_async(std::move(t), pool));
+            }
+            results.push_back(shcoro::spawn_async(canceller(), pool));
+        };
+        auto r = shcoro::spawn_async(start(), pool);
+        pool.run();
+
+        // withdrawn from the pool or stopped before waiting, none is lost
+        EXPECT_EQ(cancelled.load(), waiter_num);
+    }
+}
+
+TEST(CancellationTest, WaitThatCanNotBeWithdrawnCompletes) {
+    KeepingScheduler sched;
+    shcoro::CancellationSource source;
+    int resumed = -1;
+
+    auto task = [&]() -> shcoro::Async<void> { resumed = co_await shcoro::FIFOAwaiter{}; };
+
+    auto t = task();
+    t.set_cancellation_token(source.token());
+    auto r = shcoro::spawn_async(std::move(t), sched);
+    source.request_cancellation();
+    // the scheduler still owns the registration, nothing was resumed
+    EXPECT_EQ(resumed, -1);
+
+    ASSERT_EQ(sched.coros_.size(), 1u);
+    sched.coros_[0].resume();
+    EXPECT_EQ(resumed, 1);
+}
+
+TEST(CancellationTest, RequestedBeforeWaiting) {
+    shcoro::SteadyTimedScheduler sched;
+    shcoro::CancellationSource source;
+    source.request_cancellation();
+
+    auto task = [&]() -> shcoro::Async<bool> {
+        co_return co_await shcoro::TimedAwaiter{10s};
+    };
+
+    auto t = task();
+    t.set_cancellation_token(source.token());
+    auto r = shcoro::spawn_async(std::move(t), sched);
+    // registered with a zero deadline instead of the 10s, it still gives up the thread
+    EXPECT_EQ(sched.pending_number(), 1);
+    auto start = std::chrono::steady_clock::now();
+    sched.run();
+    EXPECT_LT(std::chrono::steady_clock::now() - start, 1s);
+    EXPECT_FALSE(r.get());
+}
+
+TEST(CancellationTest, CancelledLoopStillYields) {
+    shcoro::IntrusiveFIFOScheduler sched;
+    shcoro::CancellationSource source;
+    source.request_cancellation();
+    std::vector<std::string> trace;
+
+    // ignores the results, every wait must still hand the thread over
+    auto looping = [&]() -> shcoro::Async<void> {
+        shcoro::MutexLock mutex;
+        (void)co_await mutex.lock();
+        for (int i = 0; i < 3; i++) {
+            (void)co_await shcoro::FIFOAwaiter{};
+            trace.push_back("yield");
+            (void)co_await mutex.lock();
+            trace.push_back("lock");
+        }
+    };
+    auto other = [&]() -> shcoro::Async<void> {
+        for (int i = 0; i < 6; i++) {
+            co_await shcoro::FIFOAwaiter{};
+            trace.push_back("other");
+        }
+    };
+
+    auto t = looping();
+    t.set_cancellation_token(source.token());
+    auto r1 = shcoro::spawn_async(std::move(t), sched);
+    auto r2 = shcoro::spawn_async(other(), sched);
+    sched.run();
+    EXPECT_EQ(trace, (std::vector<std::string>{"yield", "other", "lock", "other", "yield",
+                                               "other", "lock", "other", "yield", "other",
+                                               "lock", "other"}));
+}
+
+TEST(CancellationTest, TokenFlowsIntoNestedAsync) {
+    shcoro::SteadyTimedScheduler sched;
+    shcoro::CancellationSource source;
+    std::vector<std::string> trace;
+
+    auto inner = [&]() -> shcoro::Async<void> {
+        auto token = co_await shcoro::GetCancellationTokenAwaiter{};
+        EXPECT_EQ(token, source.token());
+        bool expired = co_await shcoro::TimedAwaiter{10s};
+        if (!expired) {
+            trace.push_back("inner cancelled");
+        }
+    };
+    auto outer = [&]() -> shcoro::Async<void> {
+        co_await inner();
+        trace.push_back("outer done");
+    };
+
+    auto t = outer();
+    t.set_cancellation_token(source.token());
+    auto r = shcoro::spawn_async(std::move(t), sched);
+    source.request_cancellation();
+    EXPECT_EQ(trace, (std::vector<std::string>{"inner cancelled", "outer done"}));
+}
+
+TEST(CancellationTest, AnyOfCancelsLosers) {
+    shcoro::SteadyTimedScheduler sched;
+    std::vector<std::string> trace;
+    size_t pending_after = 1;
+
+    auto wait = [&](std::chrono::milliseconds delay, int id) -> shcoro::Async<int> {
+        bool expired = co_await shcoro::TimedAwaiter{delay};
+        if (!expired) {
+            trace.push_back("cancelled " + std::to_string(id));
+        }
+        co_return id;
+    };
+    auto task = [&]() -> shcoro::Async<size_t> {
+        auto ret = co_await shcoro::any_of(wait(10s, 0), wait(10ms, 1));
+        pending_after = sched.pending_number();
+        co_return ret.index();
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    auto r = shcoro::spawn_async(task(), sched);
+    sched.run();
+
+    EXPECT_EQ(r.get(), 1u);
+    EXPECT_EQ(trace, (std::vector<std::string>{"cancelled 0"}));
+    // the 10s timer was withdrawn before any_of returned
+    EXPECT_EQ(pending_after, 0u);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, 5s);
+}
+
+TEST(CancellationTest, AnyOfForwardsCancellation) {
+    shcoro::SteadyTimedScheduler sched;
+    shcoro::CancellationSource source;
+    int cancelled = 0;
+
+    auto wait = [&]() -> shcoro::Async<void> {
+        bool expired = co_await shcoro::TimedAwaiter{10s};
+        if (!expired) {
+            cancelled++;
+        }
+    };
+    auto task = [&]() -> shcoro::Async<void> { co_await shcoro::any_of(wait(), wait()); };
+
+    auto t = task();
+    t.set_cancellation_token(source.token());
+    auto r = shcoro::spawn_async(std::move(t), sched);
+    EXPECT_EQ(sched.pending_number(), 2);
+
+    source.request_cancellation();
+    EXPECT_EQ(cancelled, 2);
+    EXPECT_EQ(sched.pending_number(), 0);
+}
+
+TEST(CancellationTest, AnyOfCancelsAsyncMutexWait) {
+    shcoro::IntrusiveFIFOScheduler sched;
+    shcoro::AsyncMutex mutex;
+    std::vector<std::string> trace;
+
+    auto lock_once = [&]() -> shcoro::Async<int> {
+        bool locked = co_await mutex.lock();
+        if (!locked) {
+            trace.push_back("cancelled");
+            co_return -1;
+        }
+        trace.push_back("locked");
+        mutex.unlock();
+        co_return 1;
+    };
+    auto quick = [&]() -> shcoro::Async<int> {
+        co_await shcoro::FIFOAwaiter{};
+        co_return 2;
+    };
+    auto task = [&]() -> shcoro::Async<void> {
+        auto ret = co_await shcoro::any_of(lock_once(), quick());
+        trace.push_back("index " + std::to_string(ret.index()));
+    };
+
+    ASSERT_TRUE(mutex.try_lock());
+    auto r = shcoro::spawn_async(task(), sched);
+    sched.run();
+    // quick won, the loser left the mutex without waiting for the holder
+    EXPECT_EQ(trace, (std::vector<std::string>{"cancelled", "index 1"}));
+    mutex.unlock();
+    EXPECT_TRUE(mutex.try_lock());
+}
+
+TEST(CancellationTest, AnyOfAbandonsLoserIgnoringCancellation) {
+    shcoro::IntrusiveFIFOScheduler sched;
+    shcoro::MutexLock mutex;
+    std::vector<std::string> trace;
+
+    struct Unwound {
+        std::vector<std::string>& trace_;
+        ~Unwound() { trace_.push_back("loser destroyed"); }
+    };
+    auto yielding = [&]() -> shcoro::Async<int> {
+        Unwound unwound{trace};
+        for (;;) {
+            (void)co_await shcoro::FIFOAwaiter{};
+        }
+    };
+    auto locking = [&]() -> shcoro::Async<int> {
+        Unwound unwound{trace};
+        for (;;) {
+            (void)co_await mutex.lock();
+        }
+    };
+    auto quick = [&]() -> shcoro::Async<int> {
+        co_await shcoro::FIFOAwaiter{};
+        co_return 2;
+    };
+    auto task = [&]() -> shcoro::Async<void> {
+        auto ret = co_await shcoro::any_of(yielding(), locking(), quick());
+        trace.push_back("index " + std::to_string(ret.index()));
+    };
+
+    ASSERT_TRUE(mutex.try_lock());
+    auto r = shcoro::spawn_async(task(), sched);
+    sched.run();
+    // the losers parked in their next wait and were destroyed along with any_of
+    EXPECT_EQ(trace, (std::vector<std::string>{"loser destroyed", "loser destroyed",
+                                               "index 2"}));
+    EXPECT_EQ(sched.pending_number(), 0);
+}
+
+TEST(CancellationTest, AllOfChildrenAreNotAbandoned) {
+    shcoro::IntrusiveFIFOScheduler sched;
+    int yields = 0;
+
+    // ignores the cancellation, but runs side by side with its sibling
+    auto yielding = [&]() -> shcoro::Async<void> {
+        for (int i = 0; i < 5; i++) {
+            (void)co_await shcoro::FIFOAwaiter{};
+            yields++;
+        }
+    };
+    auto loser = [&]() -> shcoro::Async<int> {
+        co_await shcoro::all_of(yielding(), yielding());
+        co_return 1;
+    };
+    auto quick = [&]() -> shcoro::Async<int> {
+        co_await shcoro::FIFOAwaiter{};
+        co_return 2;
+    };
+    auto task = [&]() -> shcoro::Async<size_t> {
+        auto ret = co_await shcoro::any_of(loser(), quick());
+        co_return ret.index();
+    };
+
+    auto r = shcoro::spawn_async(task(), sched);
+    sched.run();
+    EXPECT_EQ(r.get(), 1u);
+    EXPECT_EQ(yields, 10);
+}
+
+TEST(CancellationTest, MutexWaiterLeavesQueue) {
+    shcoro::MutexLock mutex;
+    shcoro::CancellationSource source;
+    std::vector<std::string> trace;
+
+    auto task = [&](std::string name) -> shcoro::Async<void> {
+        auto guard = co_await mutex.scoped_lock();
+        trace.push_back(name + (guard ? " locked" : " cancelled"));
+    };
+
+    ASSERT_TRUE(mutex.try_lock());
+    auto t = task("a");
+    t.set_cancellation_token(source.token());
+    auto r1 = shcoro::spawn_async(std::move(t));
+    auto r2 = shcoro::spawn_async(task("b"));
+
+    source.request_cancellation();
+    EXPECT_EQ(trace, (std::vector<std::string>{"a cancelled"}));
+    // handed to the next waiter, not to the cancelled one
+    mutex.unlock();
+    EXPECT_EQ(trace, (std::vector<std::string>{"a cancelled", "b locked"}));
+    EXPECT_TRUE(mutex.try_lock());
+}
+
+TEST(CancellationTest, CancelledWriterLetsReadersIn) {
+    shcoro::RWLock<shcoro::RWLockPolicy::FAIR> lock;
+    shcoro::CancellationSource source;
+    std::vector<std::string> trace;
+
+    auto writer = [&]() -> shcoro::Async<void> {
+        bool locked = co_await lock.write_lock();
+        trace.push_back(locked ? "write" : "write cancelled");
+    };
+    auto reader = [&]() -> shcoro::Async<void> {
+        co_await lock.read_lock();
+        trace.push_back("read");
+    };
+
+    ASSERT_TRUE(lock.try_read_lock());
+    auto t = writer();
+    t.set_cancellation_token(source.token());
+    auto r1 = shcoro::spawn_async(std::move(t));
+    // queued behind the writer
+    auto r2 = shcoro::spawn_async(reader());
+    EXPECT_TRUE(trace.empty());
+
+    source.request_cancellation();
+    EXPECT_EQ(trace, (std::vector<std::string>{"read", "write cancelled"}));
+}
+
+TEST(CancellationTest, SemaphoreWaiterGetsNoUnit) {
+    shcoro::AsyncSemaphore<> sem(0);
+    shcoro::CancellationSource source;
+    bool acquired = true;
+
+    auto task = [&]() -> shcoro::Async<void> { acquired = co_await sem.acquire(); };
+
+    auto t = task();
+    t.set_cancellation_token(source.token());
+    auto r = shcoro::spawn_async(std::move(t));
+    source.request_cancellation();
+    EXPECT_FALSE(acquired);
+
+    sem.release();
+    EXPECT_EQ(sem.available(), 1u);
+}
+
+TEST(CancellationTest, ChannelReceiverLeavesQueue) {
+    shcoro::Channel<int, 1> ch;
+    shcoro::CancellationSource source;
+    std::vector<std::string> trace;
+
+    auto receiver = [&](std::string name) -> shcoro::Async<void> {
+        auto value = co_await ch.recv();
+        trace.push_back(name + (value ? " " + std::to_string(*value) : " cancelled"));
+    };
+
+    auto t = receiver("a");
+    t.set_cancellation_token(source.token());
+    auto r1 = shcoro::spawn_async(std::move(t));
+    auto r2 = shcoro::spawn_async(receiver("b"));
+
+    source.request_cancellation();
+    EXPECT_EQ(trace, (std::vector<std::string>{"a cancelled"}));
+    auto r3 = shcoro::spawn_async([&]() -> shcoro::Async<void> { co_await ch.send(42); }());
+    EXPECT_EQ(trace, (std::vector<std::string>{"a cancelled", "b 42"}));
+    EXPECT_EQ(ch.size(), 0u);
+}
+
+TEST(CancellationTest, LatchWaiterLeavesQueue) {
+    shcoro::AsyncLatch<> latch(1);
+    shcoro::CancellationSource source;
+    std::vector<bool> results;
+
+    auto task = [&]() -> shcoro::Async<void> { results.push_back(co_await latch.wait()); };
+
+    auto t = task();
+    t.set_cancellation_token(source.token());
+    auto r1 = shcoro::spawn_async(std::move(t));
+    auto r2 = shcoro::spawn_async(task());
+
+    source.request_cancellation();
+    EXPECT_EQ(results, (std::vector<bool>{false}));
+    latch.count_down();
+    EXPECT_EQ(results, (std::vector<bool>{false, true}));
+}
+
+TEST(CancellationTest, CancelledArrivalIsWithdrawn) {
+    shcoro::AsyncBarrier<> barrier(2);
+    shcoro::CancellationSource source;
+    std::vector<std::string> trace;
+
+    auto task = [&](std::string name) -> shcoro::Async<void> {
+        bool passed = co_await barrier.arrive_and_wait();
+        trace.push_back(name + (passed ? " passed" : " cancelled"));
+    };
+
+    auto t = task("a");
+    t.set_cancellation_token(source.token());
+    auto r1 = shcoro::spawn_async(std::move(t));
+    source.request_cancellation();
+    EXPECT_EQ(trace, (std::vector<std::string>{"a cancelled"}));
+
+    // the phase still needs two arrivals
+    auto r2 = shcoro::spawn_async(task("b"));
+    EXPECT_EQ(barrier.phase(), 0u);
+    auto r3 = shcoro::spawn_async(task("c"));
+    EXPECT_EQ(trace, (std::vector<std::string>{"a cancelled", "b passed", "c passed"}));
+    EXPECT_EQ(barrier.phase(), 1u);
+}
@@ -0,0 +1,130 @@
+#include "shcoro/stackless/channel.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "shcoro/stackless/fifo_scheduler.hpp"
+#include "shcoro/stackless/utility.hpp"
+#include "shcoro/stackless/work_stealing_scheduler.hpp"
+
+TEST(ChannelTest, FullBufferSuspendsSender) {
+    shcoro::IntrusiveFIFOScheduler sched;
+    shcoro::Channel<int, 2> channel;
+    std::vector<std::string> trace;
+
+    auto producer = [&]() -> shcoro::Async<void> {
+        for (int i = 0; i < 4; i++) {
+            co_await channel.send(i);
+            trace.push_back("sent " + std::to_string(i));
+        }
+        channel.close();
+    };
+    auto consumer = [&]() -> shcoro::Async<void> {
+        while (auto value = co_await channel.recv()) {
+            trace.push_back("recv " + std::to_string(*value));
+        }
+    };
+
+    auto r1 = shcoro::spawn_async(producer(), sched);
+    // the third send waits for room in the buffer
+    EXPECT_EQ(trace, (std::vector<std::string>{"sent 0", "sent 1"}));
+    EXPECT_EQ(channel.size(), 2u);
+
+    auto r2 = shcoro::spawn_async(consumer(), sched);
+    sched.run();
+    // the first receive moves the parked value into the buffer and resumes its sender
+    EXPECT_EQ(trace, (std::vector<std::string>{"sent 0", "sent 1", "sent 2", "recv 0",
+                                               "sent 3", "recv 1", "recv 2", "recv 3"}));
+    EXPECT_TRUE(channel.closed());
+}
+
+TEST(ChannelTest, ParkedReceiverGetsValueDirectly) {
+    shcoro::Channel<std::unique_ptr<int>> channel(1);
+    std::unique_ptr<int> received;
+
+    auto consumer = [&]() -> shcoro::Async<void> {
+        auto value = co_await channel.recv();
+        received = std::move(*value);
+    };
+    auto producer = [&]() -> shcoro::Async<bool> {
+        co_return co_await channel.send(std::make_unique<int>(42));
+    };
+
+    auto r1 = shcoro::spawn_async(consumer());
+    EXPECT_FALSE(received);
+    EXPECT_TRUE(shcoro::spawn_async(producer()).get());
+    ASSERT_TRUE(received);
+    EXPECT_EQ(*received, 42);
+    // handed over, never buffered
+    EXPECT_EQ(channel.size(), 0u);
+}
+
+TEST(ChannelTest, UnbufferedRendezvous) {
+    shcoro::Channel<int> channel(0);
+    bool sent = false;
+
+    auto producer = [&]() -> shcoro::Async<void> { sent = co_await channel.send(7); };
+
+    auto r = shcoro::spawn_async(producer());
+    EXPECT_FALSE(sent);
+    EXPECT_EQ(channel.try_recv(), 7);
+    EXPECT_TRUE(sent);
+    EXPECT_EQ(channel.try_recv(), std::nullopt);
+}
+
+TEST(ChannelTest, CloseWakesParkedWaiters) {
+    shcoro::Channel<int, 1> channel;
+    std::vector<std::string> trace;
+
+    auto consumer = [&]() -> shcoro::Async<void> {
+        auto value = co_await channel.recv();
+        trace.push_back(value ? "value" : "closed");
+    };
+
+    auto r1 = shcoro::spawn_async(consumer());
+    channel.close();
+    EXPECT_EQ(trace, (std::vector<std::string>{"closed"}));
+
+    auto producer = [&]() -> shcoro::Async<bool> { co_return co_await channel.send(1); };
+    EXPECT_FALSE(shcoro::spawn_async(producer()).get());
+}
+
+TEST(ChannelTest, ThreadSafeAcrossWorkers) {
+    shcoro::WorkStealingScheduler pool(4);
+    shcoro::Channel<int, 8, std::mutex> channel;
+    constexpr int producer_num = 8;
+    constexpr int message_num = 500;
+    std::atomic<long> sum{0};
+    std::atomic<int> received{0};
+    std::atomic<int> producing{producer_num};
+
+    auto producer = [&]() -> shcoro::Async<void> {
+        for (int i = 1; i <= message_num; i++) {
+            co_await channel.send(i);
+        }
+        if (--producing == 0) channel.close();
+    };
+    auto consumer = [&]() -> shcoro::Async<void> {
+        while (auto value = co_await channel.recv()) {
+            sum += *value;
+            received++;
+        }
+    };
+
+    std::vector<shcoro::AsyncRO<void>> results;
+    for (int i = 0; i < 4; i++) {
+        results.push_back(shcoro::spawn_async(consumer(), pool));
+    }
+    for (int i = 0; i < producer_num; i++) {
+        results.push_back(shcoro::spawn_async(producer(), pool));
+    }
+    pool.run();
+
+    EXPECT_EQ(received, producer_num * message_num);
+    EXPECT_EQ(sum, long{producer_num} * message_num * (message_num + 1) / 2);
+}
@@ -0,0 +1,210 @@
+#include "shcoro/stackless/epoll_scheduler.hpp"
+
+#include <arpa/inet.h>
+#include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "shcoro/stackless/utility.hpp"
+
+namespace {
+
+struct SocketPair {
+    SocketPair() { ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds_); }
+    ~SocketPair() {
+        ::close(fds_[0]);
+        ::close(fds_[1]);
+    }
+    int fds_[2]{-1, -1};
+};
+
+}  // namespace
+
+TEST(EpollSchedulerTest, ReadWaitsForWriter) {
+    shcoro::EpollScheduler sched;
+    SocketPair sp;
+    std::string received;
+
+    auto reader = [&]() -> shcoro::Async<void> {
+        char buf[16];
+        ssize_t n = co_await shcoro::async_read(sp.fds_[0], buf, sizeof(buf));
+        received.assign(buf, n > 0 ? n : 0);
+    };
+    auto writer = [&]() -> shcoro::Async<ssize_t> {
+        co_return co_await shcoro::async_write(sp.fds_[1], "hello", 5);
+    };
+
+    auto r1 = shcoro::spawn_async(reader(), sched);
+    EXPECT_EQ(sched.pending_number(), 1);
+    auto r2 = shcoro::spawn_async(writer(), sched);
+    sched.run();
+
+    EXPECT_EQ(r2.get(), 5);
+    EXPECT_EQ(received, "hello");
+    EXPECT_EQ(sched.pending_number(), 0);
+}
+
+TEST(EpollSchedulerTest, WriteWaitsForBufferSpace) {
+    shcoro::EpollScheduler sched;
+    SocketPair sp;
+
+    // fill the send buffer until write would block
+    char chunk[4096]{};
+    size_t filled = 0;
+    ssize_t n;
+    while ((n = ::write(sp.fds_[1], chunk, sizeof(chunk))) > 0) {
+        filled += n;
+    }
+
+    bool written = false;
+    auto writer = [&]() -> shcoro::Async<void> {
+        ssize_t n = co_await shcoro::async_write(sp.fds_[1], chunk, sizeof(chunk), true);
+        written = n > 0;
+    };
+    auto drainer = [&]() -> shcoro::Async<void> {
+        char buf[4096];
+        size_t drained = 0;
+        while (drained < filled) {
+            ssize_t n = co_await shcoro::async_read(sp.fds_[0], buf, sizeof(buf), true);
+            if (n <= 0) break;
+            drained += n;
+        }
+    };
+
+    auto r1 = shcoro::spawn_async(writer(), sched);
+    EXPECT_FALSE(written);
+    auto r2 = shcoro::spawn_async(drainer(), sched);
+    sched.run();
+    EXPECT_TRUE(written);
+}
+
+TEST(EpollSchedulerTest, AcceptLoopback) {
+    shcoro::EpollScheduler sched;
+    int listener = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ASSERT_EQ(::bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+    ASSERT_EQ(::listen(listener, 4), 0);
+    socklen_t len = sizeof(addr);
+    ::getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &len);
+
+    std::string received;
+    auto server = [&]() -> shcoro::Async<void> {
+        int conn = co_await shcoro::async_accept(listener);
+        char buf[16];
+        ssize_t n = co_await shcoro::async_read(conn, buf, sizeof(buf));
+        received.assign(buf, n > 0 ? n : 0);
+        sched.forget(conn);
+        ::close(conn);
+    };
+
+    auto r = shcoro::spawn_async(server(), sched);
+    EXPECT_EQ(sched.pending_number(), 1);
+
+    int client = ::socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_EQ(::connect(client, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+    ::write(client, "ping", 4);
+    sched.run();
+
+    EXPECT_EQ(received, "ping");
+    ::close(client);
+    ::close(listener);
+}
+
+TEST(EpollSchedulerTest, DestroyedWaiterIsUnregistered) {
+    shcoro::EpollScheduler sched;
+    SocketPair sp;
+
+    auto reader = [&]() -> shcoro::Async<void> {
+        char buf[16];
+        co_await shcoro::async_read(sp.fds_[0], buf, sizeof(buf));
+    };
+
+    {
+        auto r = shcoro::spawn_async(reader(), sched);
+        EXPECT_EQ(sched.pending_number(), 1);
+    }
+    EXPECT_EQ(sched.pending_number(), 0);
+    ::write(sp.fds_[1], "x", 1);
+    sched.run_once();
+}
+
+TEST(EpollSchedulerTest, PingPongOnRegisteredFds) {
+    for (bool edge_triggered : {false, true}) {
+        shcoro::EpollScheduler sched;
+        SocketPair sp;
+        int rounds = 0;
+
+        // every wait after the first finds its fd already in the epoll set
+        auto side = [&](int fd, bool serve) -> shcoro::Async<void> {
+            char c = 'x';
+            for (int i = 0; i < 100; i++) {
+                if (serve) {
+                    co_await shcoro::async_write(fd, &c, 1, edge_triggered);
+                }
+                ssize_t n = co_await shcoro::async_read(fd, &c, 1, edge_triggered);
+                EXPECT_EQ(n, 1);
+                if (!serve) {
+                    co_await shcoro::async_write(fd, &c, 1, edge_triggered);
+                    rounds++;
+                }
+            }
+        };
+
+        auto r1 = shcoro::spawn_async(side(sp.fds_[0], false), sched);
+        auto r2 = shcoro::spawn_async(side(sp.fds_[1], true), sched);
+        sched.run();
+        EXPECT_EQ(rounds, 100);
+        EXPECT_EQ(sched.pending_number(), 0);
+    }
+}
+
+TEST(EpollSchedulerTest, ForgetResumesWaiters) {
+    shcoro::EpollScheduler sched;
+    int fds[2];
+    ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+    ssize_t result = 0;
+
+    auto reader = [&]() -> shcoro::Async<void> {
+        char buf[16];
+        result = co_await shcoro::async_read(fds[0], buf, sizeof(buf));
+    };
+
+    auto r = shcoro::spawn_async(reader(), sched);
+    sched.run_once();
+    EXPECT_EQ(sched.pending_number(), 1);
+
+    // the reader retries its read on the closed fd
+    sched.forget(fds[0]);
+    ::close(fds[0]);
+    sched.run();
+    EXPECT_EQ(result, -EBADF);
+    ::close(fds[1]);
+}
+
+TEST(EpollSchedulerTest, ReadersQueueOnOneFd) {
+    for (bool edge_triggered : {false, true}) {
+        shcoro::EpollScheduler sched;
+        SocketPair sp;
+        std::string received;
+
+        auto reader = [&]() -> shcoro::Async<void> {
+            char c;
+            ssize_t n = co_await shcoro::async_read(sp.fds_[0], &c, 1, edge_triggered);
+            if (n == 1) received.push_back(c);
+        };
+
+        auto r1 = shcoro::spawn_async(reader(), sched);
+        auto r2 = shcoro::spawn_async(reader(), sched);
+        auto r3 = shcoro::spawn_async(reader(), sched);
+        EXPECT_EQ(sched.pending_number(), 3);
+
+        ASSERT_EQ(::write(sp.fds_[1], "abc", 3), 3);
+        sched.run();
+        EXPECT_EQ(received, "abc");
+    }
+}
@@ -0,0 +1,157 @@
+#include "shcoro/stackless/event_loop.hpp"
+
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "shcoro/stackless/utility.hpp"
+
+using namespace std::chrono_literals;
+
+TEST(EventLoopTest, MixedAwaiters) {
+    shcoro::EventLoop loop;
+    int fds[2];
+    ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+    std::vector<std::string> trace;
+
+    auto reader = [&]() -> shcoro::Async<void> {
+        char buf[16];
+        ssize_t n = co_await shcoro::async_read(fds[0], buf, sizeof(buf));
+        trace.emplace_back(buf, n > 0 ? n : 0);
+    };
+    auto writer = [&]() -> shcoro::Async<void> {
+        co_await shcoro::FIFOAwaiter{};
+        trace.push_back("yield");
+        co_await shcoro::TimedAwaiter{20ms};
+        trace.push_back("timer");
+        co_await shcoro::async_write(fds[1], "io", 2);
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::clock_t cpu_start = std::clock();
+    auto r1 = shcoro::spawn_async(reader(), loop);
+    auto r2 = shcoro::spawn_async(writer(), loop);
+    EXPECT_EQ(loop.pending_number(), 2);
+    loop.run();
+
+    double cpu_ms = 1000.0 * static_cast<double>(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+    EXPECT_GE(std::chrono::steady_clock::now() - start, 20ms);
+    EXPECT_LT(cpu_ms, 15.0);
+    EXPECT_EQ(trace, (std::vector<std::string>{"yield", "timer", "io"}));
+    EXPECT_EQ(loop.pending_number(), 0);
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+TEST(EventLoopTest, ReadyQueueDoesNotStarveTimers) {
+    shcoro::EventLoop loop;
+    bool fired = false;
+    int yields = 0;
+
+    auto spinner = [&]() -> shcoro::Async<void> {
+        while (!fired) {
+            yields++;
+            co_await shcoro::FIFOAwaiter{};
+        }
+    };
+    auto timer = [&]() -> shcoro::Async<void> {
+        co_await shcoro::TimedAwaiter{5ms};
+        fired = true;
+    };
+
+    auto r1 = shcoro::spawn_async(timer(), loop);
+    auto r2 = shcoro::spawn_async(spinner(), loop);
+    loop.run();
+    EXPECT_TRUE(fired);
+    EXPECT_GT(yields, 1);
+}
+
+TEST(EventLoopTest, DestroyedWaitersAreUnregistered) {
+    shcoro::EventLoop loop;
+    int fds[2];
+    ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+
+    auto sleeper = []() -> shcoro::Async<void> { co_await shcoro::TimedAwaiter{1h}; };
+    auto yielder = []() -> shcoro::Async<void> { co_await shcoro::FIFOAwaiter{}; };
+    auto reader = [&]() -> shcoro::Async<void> {
+        char buf[4];
+        co_await shcoro::async_read(fds[0], buf, sizeof(buf));
+    };
+
+    {
+        auto r1 = shcoro::spawn_async(sleeper(), loop);
+        auto r2 = shcoro::spawn_async(yielder(), loop);
+        auto r3 = shcoro::spawn_async(reader(), loop);
+        EXPECT_EQ(loop.pending_number(), 3);
+    }
+    EXPECT_EQ(loop.pending_number(), 0);
+    loop.run();
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+TEST(EventLoopTest, ScheduleOnFromOtherThreads) {
+    shcoro::EventLoop loop;
+    constexpr int thread_num = 4;
+    constexpr int task_num = 1000;
+    std::atomic<int> done{0};
+    std::atomic<int> wrong_thread{0};
+    auto loop_thread = std::this_thread::get_id();
+
+    auto task = [&]() -> shcoro::Async<void> {
+        co_await loop.schedule_on();
+        if (std::this_thread::get_id() != loop_thread) wrong_thread++;
+        // the loop is now the scheduler of the coroutine
+        co_await shcoro::FIFOAwaiter{};
+        if (++done == thread_num * task_num) loop.stop();
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < thread_num; i++) {
+        threads.emplace_back([&] {
+            for (int j = 0; j < task_num; j++) {
+                shcoro::spawn_async_detached(task());
+            }
+        });
+    }
+    loop.run_forever();
+    for (auto& t : threads) t.join();
+
+    EXPECT_EQ(done, thread_num * task_num);
+    EXPECT_EQ(wrong_thread, 0);
+}
+
+TEST(EventLoopTest, PostHandle) {
+    shcoro::EventLoop loop;
+    std::coroutine_handle<> suspended;
+    bool resumed = false;
+
+    struct Capture {
+        std::coroutine_handle<>* out_;
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> h) noexcept { *out_ = h; }
+        void await_resume() const noexcept {}
+    };
+    auto task = [&]() -> shcoro::Async<void> {
+        co_await Capture{&suspended};
+        resumed = true;
+        loop.stop();
+    };
+
+    auto r = shcoro::spawn_async(task());
+    ASSERT_TRUE(suspended);
+    std::thread other([&] {
+        std::this_thread::sleep_for(10ms);
+        loop.post(suspended);
+    });
+    loop.run_forever();
+    other.join();
+    EXPECT_TRUE(resumed);
+}
@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+#include <string>
+#include <variant>
+
+#include "shcoro/stackless/async_generator.hpp"
+#include "shcoro/stackless/fifo_scheduler.hpp"
+#include "shcoro/stackless/utility.hpp"
+
+#if SHCORO_EXCEPTIONS
+
+namespace {
+
+shcoro::Async<int> fail_after_yield(std::string message) {
+    co_await shcoro::FIFOAwaiter{};
+    throw std::runtime_error(message);
+    co_return 0;
+}
+
+shcoro::Async<int> value_after_yield(int value) {
+    co_await shcoro::FIFOAwaiter{};
+    co_return value;
+}
+
+}  // namespace
+
+TEST(ExceptionTest, PropagatesThroughNestedAsync) {
+    shcoro::IntrusiveFIFOScheduler sched;
+
+    auto outer = [&]() -> shcoro::Async<std::string> {
+        try {
+            co_await fail_after_yield("backend");
+        } catch (const std::runtime_error& e) {
+            co_return std::string("caught ") + e.what();
+        }
+        co_return "not thrown";
+    };
+
+    auto r = shcoro::spawn_async(outer(), sched);
+    sched.run();
+    EXPECT_EQ(r.get(), "caught backend");
+}
+
+TEST(ExceptionTest, RethrownFromAsyncROGet) {
+    shcoro::IntrusiveFIFOScheduler sched;
+    auto r = shcoro::spawn_async(fail_after_yield("top"), sched);
+    sched.run();
+    EXPECT_THROW(r.get(), std::runtime_error);
+
+    auto immediate = []() -> shcoro::Async<void> {
+        throw std::logic_error("immediate");
+        co_return;
+    };
+    EXPECT_THROW(shcoro::spawn_async(immediate()).get(), std::logic_error);
+}
+
+TEST(ExceptionTest, AllOfRethrows) {
+    shcoro::IntrusiveFIFOScheduler sched;
+
+    auto task = [&]() -> shcoro::Async<bool> {
+        try {
+            co_await shcoro::all_of(value_after_yield(1), fail_after_yield("all_of"));
+        } catch (const std::runtime_error&) {
+            co_return true;
+        }
+        co_return false;
+    };
+
+    auto r = shcoro::spawn_async(task(), sched);
+    sched.run();
+    EXPECT_TRUE(r.get());
+}
+
+TEST(ExceptionTest, AnyOfRethrowsFailedWinner) {
+    shcoro::IntrusiveFIFOScheduler sched;
+
+    auto failing = []() -> shcoro::Async<int> {
+        throw std::runtime_error("any_of");
+        co_return 0;
+    };
+    auto task = [&]() -> shcoro::Async<bool> {
+        try {
+            co_await shcoro::any_of(failing(), value_after_yield(2));
+        } catch (const std::runtime_error&) {
+            co_return true;
+        }
+        co_return false;
+    };
+
+    auto r = shcoro::spawn_async(task(), sched);
+    sched.run();
+    EXPECT_TRUE(r.get());
+}
+
+TEST(ExceptionTest, AsyncGeneratorRethrowsAtEnd) {
+    auto gen = []() -> shcoro::AsyncGenerator<int> {
+        co_yield 1;
+        throw std::runtime_error("generator");
+    };
+    auto consumer = [&]() -> shcoro::Async<int> {
+        auto g = gen();
+        int sum = 0;
+        try {
+            while (auto value = co_await g.next()) {
+                sum += *value;
+            }
+        } catch (const std::runtime_error&) {
+            sum += 100;
+        }
+        co_return sum;
+    };
+
+    EXPECT_EQ(shcoro::spawn_async(consumer()).get(), 101);
+}
+
+#endif
@@ -0,0 +1,97 @@
+#include "shcoro/stackless/frame_allocator.hpp"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+
+#include "shcoro/stackless/utility.hpp"
+
+namespace {
+
+struct AllocStats {
+    size_t allocated{0};
+    size_t deallocated{0};
+};
+
+template <typename T>
+struct CountingAllocator {
+    using value_type = T;
+
+    explicit CountingAllocator(AllocStats* stats) : stats_(stats) {}
+    template <typename U>
+    CountingAllocator(const CountingAllocator<U>& other) : stats_(other.stats_) {}
+
+    T* allocate(size_t n) {
+        stats_->allocated++;
+        return std::allocator<T>{}.allocate(n);
+    }
+    void deallocate(T* p, size_t n) {
+        stats_->deallocated++;
+        std::allocator<T>{}.deallocate(p, n);
+    }
+
+    AllocStats* stats_;
+};
+
+shcoro::Async<int> square(int x) { co_return x * x; }
+
+shcoro::Async<int> square_with(std::allocator_arg_t, CountingAllocator<int>, int x) {
+    co_return co_await square(x);
+}
+
+struct Worker {
+    shcoro::Async<int> add(std::allocator_arg_t, CountingAllocator<int>, int x) {
+        co_return base_ + x;
+    }
+    int base_{10};
+};
+
+shcoro::Async<void*> self_address() {
+    auto self = co_await shcoro::GetCoroAwaiter{};
+    co_return self.address();
+}
+
+}  // namespace
+
+TEST(FrameAllocatorTest, PooledFrameIsReused) {
+#ifdef SHCORO_DISABLE_FRAME_POOL
+    GTEST_SKIP() << "frame pool disabled";
+#endif
+    void* first = shcoro::spawn_async(self_address()).get();
+    void* second = shcoro::spawn_async(self_address()).get();
+    EXPECT_EQ(first, second);
+}
+
+TEST(FrameAllocatorTest, AllocatorArg) {
+    AllocStats stats;
+    {
+        auto r = shcoro::spawn_async(
+            square_with(std::allocator_arg, CountingAllocator<int>(&stats), 7));
+        EXPECT_EQ(r.get(), 49);
+        EXPECT_EQ(stats.allocated, 1u);
+    }
+    EXPECT_EQ(stats.deallocated, 1u);
+}
+
+TEST(FrameAllocatorTest, AllocatorArgMember) {
+    AllocStats stats;
+    Worker worker;
+    {
+        auto r = shcoro::spawn_async(
+            worker.add(std::allocator_arg, CountingAllocator<int>(&stats), 5));
+        EXPECT_EQ(r.get(), 15);
+    }
+    EXPECT_EQ(stats.allocated, 1u);
+    EXPECT_EQ(stats.deallocated, 1u);
+}
+
+TEST(FrameAllocatorTest, LargeFrame) {
+    auto big = []() -> shcoro::Async<int> {
+        char buffer[8192];
+        buffer[0] = 1;
+        co_await shcoro::GetCoroAwaiter{};
+        buffer[sizeof(buffer) - 1] = 2;
+        co_return buffer[0] + buffer[sizeof(buffer) - 1];
+    };
+    EXPECT_EQ(shcoro::spawn_async(big()).get(), 3);
+}
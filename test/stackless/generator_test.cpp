@@ -2,6 +2,10 @@
 
 #include <gtest/gtest.h>
 
+#include <ranges>
+#include <stdexcept>
+#include <vector>
+
 TEST(GeneratorTest, Basic) {
     auto gen = []() -> shcoro::Generator<uint64_t> {
         uint64_t i = 0;
@@ -20,4 +24,161 @@ TEST(GeneratorTest, Basic) {
             break;
         }
     }
-}
\ No newline at end of file
+}
+namespace {
+
+struct Record {
+    explicit Record(int id) : id_(id) {}
+    Record(const Record& other) : id_(other.id_) { copies++; }
+    Record& operator=(const Record&) = delete;
+
+    int id_;
+    static inline int copies = 0;
+};
+
+}  // namespace
+
+TEST(GeneratorTest, YieldsWithoutCopies) {
+    auto gen = []() -> shcoro::Generator<Record> {
+        Record record(0);
+        for (int i = 0; i < 3; i++) {
+            record.id_ = i;
+            co_yield record;
+        }
+        // a temporary lives until the generator is resumed
+        co_yield Record(3);
+    };
+
+    Record::copies = 0;
+    int expected = 0;
+    for (const Record& record : gen()) {
+        EXPECT_EQ(record.id_, expected++);
+    }
+    EXPECT_EQ(expected, 4);
+    EXPECT_EQ(Record::copies, 0);
+}
+
+TEST(GeneratorTest, YieldsReferences) {
+    std::vector<int> values{1, 2, 3};
+    auto gen = [](std::vector<int>& v) -> shcoro::Generator<int&> {
+        for (auto& value : v) {
+            co_yield value;
+        }
+    };
+
+    for (int& value : gen(values)) {
+        value *= 10;
+    }
+    EXPECT_EQ(values, (std::vector<int>{10, 20, 30}));
+
+    auto const_gen = [](const std::vector<int>& v) -> shcoro::Generator<const int&> {
+        for (const auto& value : v) {
+            co_yield value;
+        }
+    };
+    std::vector<const int*> addresses;
+    for (const int& value : const_gen(values)) {
+        addresses.push_back(&value);
+    }
+    EXPECT_EQ(addresses, (std::vector<const int*>{&values[0], &values[1], &values[2]}));
+}
+
+static_assert(std::ranges::input_range<shcoro::Generator<int>>);
+static_assert(std::ranges::view<shcoro::Generator<int>>);
+static_assert(std::input_iterator<std::ranges::iterator_t<shcoro::Generator<const int&>>>);
+
+TEST(GeneratorTest, RangeAdaptors) {
+    auto naturals = []() -> shcoro::Generator<int> {
+        for (int i = 0;; i++) {
+            co_yield i;
+        }
+    };
+
+    std::vector<int> values;
+    for (int value : naturals() | std::views::filter([](int v) { return v % 3 == 0; }) |
+                         std::views::transform([](int v) { return v * 2; }) |
+                         std::views::take(4)) {
+        values.push_back(value);
+    }
+    EXPECT_EQ(values, (std::vector<int>{0, 6, 12, 18}));
+}
+
+namespace {
+
+struct Tree {
+    int value_;
+    std::vector<Tree> children_;
+};
+
+shcoro::Generator<int> preorder(const Tree& tree) {
+    co_yield tree.value_;
+    for (const auto& child : tree.children_) {
+        co_yield shcoro::elements_of(preorder(child));
+    }
+}
+
+shcoro::Generator<int> countdown(int n) {
+    if (n == 0) co_return;
+    co_yield n;
+    co_yield shcoro::elements_of(countdown(n - 1));
+}
+
+#if SHCORO_EXCEPTIONS
+shcoro::Generator<int> throw_after(int n) {
+    co_yield n;
+    throw std::runtime_error("nested");
+}
+#endif
+
+}  // namespace
+
+TEST(GeneratorTest, RecursiveElementsOf) {
+    Tree tree{1, {{2, {{3, {}}, {4, {}}}}, {5, {{6, {}}}}}};
+    std::vector<int> values;
+    for (int value : preorder(tree)) {
+        values.push_back(value);
+    }
+    EXPECT_EQ(values, (std::vector<int>{1, 2, 3, 4, 5, 6}));
+
+    // each element resumes the innermost generator only
+    int expected = 10000;
+    for (int value : countdown(10000)) {
+        EXPECT_EQ(value, expected--);
+    }
+    EXPECT_EQ(expected, 0);
+}
+
+TEST(GeneratorTest, ElementsOfRange) {
+    auto gen = []() -> shcoro::Generator<int> {
+        std::vector<int> values{1, 2};
+        co_yield 0;
+        co_yield shcoro::elements_of(values);
+        co_yield 3;
+    };
+
+    std::vector<int> values;
+    for (int value : gen()) {
+        values.push_back(value);
+    }
+    EXPECT_EQ(values, (std::vector<int>{0, 1, 2, 3}));
+}
+
+#if SHCORO_EXCEPTIONS
+TEST(GeneratorTest, NestedExceptionReachesParent) {
+    auto gen = []() -> shcoro::Generator<int> {
+        bool caught = false;
+        try {
+            co_yield shcoro::elements_of(throw_after(3));
+        } catch (const std::runtime_error&) {
+            caught = true;
+        }
+        if (caught) co_yield -1;
+    };
+
+    std::vector<int> values;
+    for (int value : gen()) {
+        values.push_back(value);
+    }
+    EXPECT_EQ(values, (std::vector<int>{3, -1}));
+}
+#endif
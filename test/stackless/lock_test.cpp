@@ -0,0 +1,194 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "shcoro/stackless/fifo_scheduler.hpp"
+#include "shcoro/stackless/mutex_lock.hpp"
+#include "shcoro/stackless/rw_lock.hpp"
+#include "shcoro/stackless/utility.hpp"
+
+TEST(MutexLockTest, WaitersResumeInOrder) {
+    shcoro::MutexLock mutex;
+    std::vector<int> order;
+
+    ASSERT_TRUE(mutex.try_lock());
+    auto task = [&](int id) -> shcoro::Async<void> {
+        co_await mutex.lock();
+        order.push_back(id);
+        mutex.unlock();
+    };
+
+    std::vector<shcoro::AsyncRO<void>> results;
+    for (int i = 0; i < 4; i++) {
+        results.push_back(shcoro::spawn_async(task(i)));
+    }
+    EXPECT_TRUE(order.empty());
+
+    mutex.unlock();
+    EXPECT_EQ(order, (std::vector<int>{0, 1, 2, 3}));
+    EXPECT_TRUE(mutex.try_lock());
+}
+
+TEST(RWLockTest, ReaderPriorityWakesAllWaitingReaders) {
+    shcoro::RWLock<shcoro::RWLockPolicy::READ_RPIOR> lock;
+    std::vector<std::string> trace;
+
+    ASSERT_TRUE(lock.try_write_lock());
+    auto reader = [&](std::string id) -> shcoro::Async<void> {
+        co_await lock.read_lock();
+        trace.push_back(id);
+        lock.read_unlock();
+    };
+    auto writer = [&](std::string id) -> shcoro::Async<void> {
+        co_await lock.write_lock();
+        trace.push_back(id);
+        lock.write_unlock();
+    };
+
+    auto r1 = shcoro::spawn_async(reader("r1"));
+    auto r2 = shcoro::spawn_async(writer("w1"));
+    auto r3 = shcoro::spawn_async(reader("r2"));
+    EXPECT_TRUE(trace.empty());
+
+    lock.write_unlock();
+    // readers queued behind a writer are not held back by it
+    EXPECT_EQ(trace, (std::vector<std::string>{"r1", "r2", "w1"}));
+    EXPECT_TRUE(lock.try_write_lock());
+}
+
+TEST(RWLockTest, FairGroupsReadersUntilNextWriter) {
+    shcoro::IntrusiveFIFOScheduler sched;
+    shcoro::RWLock<shcoro::RWLockPolicy::FAIR> lock;
+    std::vector<std::string> trace;
+
+    ASSERT_TRUE(lock.try_write_lock());
+    auto reader = [&](std::string id) -> shcoro::Async<void> {
+        co_await lock.read_lock();
+        trace.push_back(id);
+        // keep the read lock until the scheduler runs
+        co_await shcoro::FIFOAwaiter{};
+        trace.push_back(id + " done");
+        lock.read_unlock();
+    };
+    auto writer = [&](std::string id) -> shcoro::Async<void> {
+        co_await lock.write_lock();
+        trace.push_back(id);
+        lock.write_unlock();
+    };
+
+    auto r1 = shcoro::spawn_async(reader("r1"), sched);
+    auto r2 = shcoro::spawn_async(reader("r2"), sched);
+    auto r3 = shcoro::spawn_async(writer("w1"), sched);
+    auto r4 = shcoro::spawn_async(reader("r3"), sched);
+
+    lock.write_unlock();
+    // both readers in front of the writer hold the lock together
+    EXPECT_EQ(trace, (std::vector<std::string>{"r1", "r2"}));
+    sched.run();
+    EXPECT_EQ(trace, (std::vector<std::string>{"r1", "r2", "r1 done", "r2 done", "w1", "r3",
+                                               "r3 done"}));
+}
+
+TEST(RWLockTest, WriterPriorityHoldsBackNewReaders) {
+    shcoro::IntrusiveFIFOScheduler sched;
+    shcoro::RWLock<shcoro::RWLockPolicy::WRITE_PRIOR> lock;
+    std::vector<std::string> trace;
+
+    ASSERT_TRUE(lock.try_read_lock());
+    auto reader = [&](std::string id) -> shcoro::Async<void> {
+        co_await lock.read_lock();
+        trace.push_back(id);
+        co_await shcoro::FIFOAwaiter{};
+        trace.push_back(id + " done");
+        lock.read_unlock();
+    };
+    auto writer = [&](std::string id) -> shcoro::Async<void> {
+        co_await lock.write_lock();
+        trace.push_back(id);
+        co_await shcoro::FIFOAwaiter{};
+        lock.write_unlock();
+    };
+
+    auto r1 = shcoro::spawn_async(writer("w1"), sched);
+    // the lock is read locked but a writer waits
+    EXPECT_FALSE(lock.try_read_lock());
+    auto r2 = shcoro::spawn_async(reader("r1"), sched);
+    auto r3 = shcoro::spawn_async(writer("w2"), sched);
+    auto r4 = shcoro::spawn_async(reader("r2"), sched);
+    EXPECT_TRUE(trace.empty());
+
+    lock.read_unlock();
+    sched.run();
+    // both writers go first, then the readers together
+    EXPECT_EQ(trace,
+              (std::vector<std::string>{"w1", "w2", "r1", "r2", "r1 done", "r2 done"}));
+    EXPECT_TRUE(lock.try_write_lock());
+}
+
+TEST(MutexLockTest, ScopedLockReleasesOnEarlyReturn) {
+    shcoro::MutexLock mutex;
+
+    auto task = [&](bool early) -> shcoro::Async<int> {
+        auto guard = co_await mutex.scoped_lock();
+        if (early) co_return 1;
+        guard.unlock();
+        co_return 2;
+    };
+
+    EXPECT_EQ(shcoro::spawn_async(task(true)).get(), 1);
+    EXPECT_TRUE(mutex.try_lock());
+    mutex.unlock();
+    EXPECT_EQ(shcoro::spawn_async(task(false)).get(), 2);
+    EXPECT_TRUE(mutex.try_lock());
+}
+
+TEST(MutexLockTest, RescheduledHandOverDoesNotRecurse) {
+    shcoro::IntrusiveFIFOScheduler sched;
+    shcoro::MutexLock mutex(shcoro::WakeupPolicy::RESCHEDULE);
+    constexpr int task_num = 100000;
+    int done = 0;
+
+    ASSERT_TRUE(mutex.try_lock());
+    auto task = [&]() -> shcoro::Async<void> {
+        auto guard = co_await mutex.scoped_lock();
+        done++;
+    };
+
+    std::vector<shcoro::AsyncRO<void>> results;
+    results.reserve(task_num);
+    for (int i = 0; i < task_num; i++) {
+        results.push_back(shcoro::spawn_async(task(), sched));
+    }
+
+    mutex.unlock();
+    // the next owner is queued, not resumed on the unlocker's stack
+    EXPECT_EQ(done, 0);
+    EXPECT_EQ(sched.pending_number(), 1);
+    sched.run();
+    EXPECT_EQ(done, task_num);
+    EXPECT_TRUE(mutex.try_lock());
+}
+
+TEST(RWLockTest, RescheduledReadersHoldTheLock) {
+    shcoro::IntrusiveFIFOScheduler sched;
+    shcoro::RWLock<shcoro::RWLockPolicy::FAIR> lock(shcoro::WakeupPolicy::RESCHEDULE);
+    std::vector<std::string> trace;
+
+    ASSERT_TRUE(lock.try_write_lock());
+    auto reader = [&](std::string id) -> shcoro::Async<void> {
+        auto guard = co_await lock.scoped_read_lock();
+        trace.push_back(id);
+    };
+
+    auto r1 = shcoro::spawn_async(reader("r1"), sched);
+    auto r2 = shcoro::spawn_async(reader("r2"), sched);
+    lock.write_unlock();
+
+    // handed over but not resumed yet, a writer must not get in
+    EXPECT_TRUE(trace.empty());
+    EXPECT_FALSE(lock.try_write_lock());
+    sched.run();
+    EXPECT_EQ(trace, (std::vector<std::string>{"r1", "r2"}));
+    EXPECT_TRUE(lock.try_write_lock());
+}
@@ -0,0 +1,82 @@
+#include "shcoro/stackless/mux.hpp"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <tuple>
+#include <variant>
+#include <vector>
+
+#include "shcoro/stackless/fifo_scheduler.hpp"
+#include "shcoro/stackless/utility.hpp"
+
+namespace {
+
+shcoro::Async<int> value_now(int value) { co_return value; }
+
+shcoro::Async<int> value_after_yields(int value, int yields) {
+    for (int i = 0; i < yields; i++) {
+        co_await shcoro::FIFOAwaiter{};
+    }
+    co_return value;
+}
+
+}  // namespace
+
+TEST(MuxTest, AllOfMixesReadyAndSuspendedTasks) {
+    shcoro::IntrusiveFIFOScheduler sched;
+
+    auto task = [&]() -> shcoro::Async<int> {
+        auto [a, b, c] = co_await shcoro::all_of(value_after_yields(1, 2), value_now(2),
+                                                 value_after_yields(3, 1));
+        co_return a * 100 + b * 10 + c;
+    };
+
+    auto r = shcoro::spawn_async(task(), sched);
+    sched.run();
+    EXPECT_EQ(r.get(), 123);
+}
+
+TEST(MuxTest, AllOfOfReadyTasksDoesNotSuspend) {
+    auto task = [&]() -> shcoro::Async<int> {
+        auto [a, b] = co_await shcoro::all_of(value_now(1), value_now(2));
+        co_return a + b;
+    };
+
+    // no scheduler, the result is there once spawn_async returns
+    auto r = shcoro::spawn_async(task());
+    EXPECT_EQ(r.get(), 3);
+}
+
+TEST(MuxTest, AnyOfReadyTaskSkipsTheRest) {
+    std::vector<std::string> trace;
+
+    auto traced = [&](std::string name) -> shcoro::Async<void> {
+        trace.push_back(name);
+        co_return;
+    };
+    auto task = [&]() -> shcoro::Async<size_t> {
+        auto ret = co_await shcoro::any_of(traced("a"), traced("b"));
+        co_return ret.index();
+    };
+
+    auto r = shcoro::spawn_async(task());
+    EXPECT_EQ(r.get(), 0u);
+    EXPECT_EQ(trace, (std::vector<std::string>{"a"}));
+}
+
+TEST(MuxTest, AnyOfReturnsFirstToFinish) {
+    shcoro::IntrusiveFIFOScheduler sched;
+
+    auto task = [&]() -> shcoro::Async<int> {
+        auto ret = co_await shcoro::any_of(value_after_yields(1, 3),
+                                           value_after_yields(2, 1),
+                                           value_after_yields(3, 2));
+        EXPECT_EQ(ret.index(), 1u);
+        co_return std::get<1>(ret).value;
+    };
+
+    auto r = shcoro::spawn_async(task(), sched);
+    sched.run();
+    EXPECT_EQ(r.get(), 2);
+}
@@ -0,0 +1,66 @@
+#include "shcoro/stackless/scheduler.hpp"
+
+#include <gtest/gtest.h>
+
+namespace {
+
+struct CountingScheduler {
+    void register_coro(std::coroutine_handle<>) { registered++; }
+    void unregister_coro(std::coroutine_handle<>) { unregistered++; }
+
+    int registered{0};
+    int unregistered{0};
+};
+
+struct CountingValueScheduler {
+    using value_type = int;
+
+    void register_coro(std::coroutine_handle<>, int value) { sum += value; }
+    void unregister_coro(std::coroutine_handle<>) { unregistered++; }
+
+    int sum{0};
+    int unregistered{0};
+};
+
+}  // namespace
+
+TEST(SchedulerTest, CopyIsTrivial) {
+    static_assert(std::is_trivially_copyable_v<shcoro::Scheduler>);
+    static_assert(sizeof(shcoro::Scheduler) == 2 * sizeof(void*));
+
+    CountingScheduler counting;
+    shcoro::Scheduler sched(counting);
+    shcoro::Scheduler copy = sched;
+    EXPECT_TRUE(copy);
+    EXPECT_TRUE(copy == sched);
+    EXPECT_FALSE(shcoro::Scheduler{});
+}
+
+TEST(SchedulerTest, NoValueDispatch) {
+    CountingScheduler counting;
+    shcoro::Scheduler sched(counting);
+    shcoro::Scheduler copy = sched;
+
+    scheduler_register_coro(copy, std::noop_coroutine());
+    scheduler_register_coro(copy, std::noop_coroutine(), 1);  // ignored
+    shcoro::SchedulerNode node{.handle_ = std::noop_coroutine()};
+    scheduler_register_node(copy, node);
+    scheduler_unregister_node(copy, node);
+    scheduler_unregister_coro(copy, std::noop_coroutine());
+
+    EXPECT_EQ(counting.registered, 2);
+    EXPECT_EQ(counting.unregistered, 2);
+}
+
+TEST(SchedulerTest, WithValueDispatch) {
+    CountingValueScheduler counting;
+    shcoro::Scheduler sched(counting);
+
+    scheduler_register_coro(sched, std::noop_coroutine(), 3);
+    scheduler_register_coro(sched, std::noop_coroutine(), 4);
+    scheduler_register_coro(sched, std::noop_coroutine());  // ignored
+    scheduler_unregister_coro(sched, std::noop_coroutine());
+
+    EXPECT_EQ(counting.sum, 7);
+    EXPECT_EQ(counting.unregistered, 1);
+}
@@ -0,0 +1,129 @@
+#include "shcoro/stackless/semaphore.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "shcoro/stackless/fifo_scheduler.hpp"
+#include "shcoro/stackless/utility.hpp"
+#include "shcoro/stackless/work_stealing_scheduler.hpp"
+
+TEST(AsyncSemaphoreTest, BoundsConcurrency) {
+    shcoro::IntrusiveFIFOScheduler sched;
+    shcoro::AsyncSemaphore sem(2);
+    int inside = 0;
+    int max_inside = 0;
+
+    auto task = [&]() -> shcoro::Async<void> {
+        auto unit = co_await sem.scoped_acquire();
+        max_inside = std::max(max_inside, ++inside);
+        co_await shcoro::FIFOAwaiter{};
+        inside--;
+    };
+
+    std::vector<shcoro::AsyncRO<void>> results;
+    for (int i = 0; i < 8; i++) {
+        results.push_back(shcoro::spawn_async(task(), sched));
+    }
+    EXPECT_EQ(inside, 2);
+    sched.run();
+    EXPECT_EQ(max_inside, 2);
+    EXPECT_EQ(sem.available(), 2);
+}
+
+TEST(AsyncSemaphoreTest, BulkReleaseWakesWaitersInOrder) {
+    shcoro::AsyncSemaphore sem(0);
+    std::vector<int> order;
+
+    auto task = [&](int id) -> shcoro::Async<void> {
+        co_await sem.acquire();
+        order.push_back(id);
+    };
+
+    std::vector<shcoro::AsyncRO<void>> results;
+    for (int i = 0; i < 3; i++) {
+        results.push_back(shcoro::spawn_async(task(i)));
+    }
+    EXPECT_TRUE(order.empty());
+
+    // two units are left over once every waiter got one
+    sem.release(5);
+    EXPECT_EQ(order, (std::vector<int>{0, 1, 2}));
+    EXPECT_EQ(sem.available(), 2);
+}
+
+TEST(AsyncSemaphoreTest, ThreadSafeAcrossWorkers) {
+    shcoro::WorkStealingScheduler pool(4);
+    shcoro::AsyncSemaphore<std::mutex> sem(3);
+    std::atomic<int> inside{0};
+    std::atomic<int> overflows{0};
+
+    auto task = [&]() -> shcoro::Async<void> {
+        for (int i = 0; i < 50; i++) {
+            co_await sem.acquire();
+            if (inside.fetch_add(1) >= 3) overflows++;
+            co_await shcoro::FIFOAwaiter{};
+            inside.fetch_sub(1);
+            sem.release();
+        }
+    };
+
+    std::vector<shcoro::AsyncRO<void>> results;
+    for (int i = 0; i < 32; i++) {
+        results.push_back(shcoro::spawn_async(task(), pool));
+    }
+    pool.run();
+    EXPECT_EQ(overflows, 0);
+    EXPECT_EQ(sem.available(), 3);
+}
+
+TEST(AsyncLatchTest, WaitersResumeWhenCountReachesZero) {
+    shcoro::AsyncLatch latch(3);
+    int resumed = 0;
+
+    auto waiter = [&]() -> shcoro::Async<void> {
+        co_await latch.wait();
+        resumed++;
+    };
+
+    auto r1 = shcoro::spawn_async(waiter());
+    auto r2 = shcoro::spawn_async(waiter());
+    latch.count_down();
+    EXPECT_EQ(resumed, 0);
+    latch.count_down(2);
+    EXPECT_EQ(resumed, 2);
+
+    // an open latch does not suspend
+    auto r3 = shcoro::spawn_async(waiter());
+    EXPECT_EQ(resumed, 3);
+    EXPECT_TRUE(latch.try_wait());
+}
+
+TEST(AsyncBarrierTest, PhasesAreReused) {
+    shcoro::IntrusiveFIFOScheduler sched;
+    shcoro::AsyncBarrier barrier(3);
+    std::vector<int> trace;
+
+    auto task = [&](int id) -> shcoro::Async<void> {
+        for (int phase = 0; phase < 2; phase++) {
+            trace.push_back(phase * 10 + id);
+            co_await barrier.arrive_and_wait();
+        }
+    };
+
+    auto r1 = shcoro::spawn_async(task(1), sched);
+    auto r2 = shcoro::spawn_async(task(2), sched);
+    auto r3 = shcoro::spawn_async(task(3), sched);
+    sched.run();
+
+    // nobody enters the second phase before everybody finished the first
+    ASSERT_EQ(trace.size(), 6u);
+    for (size_t i = 0; i < 3; i++) {
+        EXPECT_LT(trace[i], 10);
+        EXPECT_GE(trace[i + 3], 10);
+    }
+    EXPECT_EQ(barrier.phase(), 2u);
+}
@@ -0,0 +1,256 @@
+#include "shcoro/stackless/timeout.hpp"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "shcoro/stackless/async_mutex.hpp"
+#include "shcoro/stackless/channel.hpp"
+#include "shcoro/stackless/timer.hpp"
+#include "shcoro/stackless/utility.hpp"
+
+using namespace std::chrono_literals;
+
+namespace {
+
+shcoro::Async<int> value_after(std::chrono::milliseconds delay, int value,
+                               std::vector<std::string>& trace) {
+    bool expired = co_await shcoro::TimedAwaiter{delay};
+    if (!expired) {
+        trace.push_back("cancelled");
+        co_return -1;
+    }
+    co_return value;
+}
+
+}  // namespace
+
+TEST(TimeoutTest, TaskFinishesFirst) {
+    shcoro::SteadyTimedScheduler sched;
+    std::vector<std::string> trace;
+    size_t pending_after = 1;
+
+    auto task = [&]() -> shcoro::Async<shcoro::expected<int, shcoro::timeout>> {
+        auto ret = co_await shcoro::with_timeout(value_after(1ms, 42, trace), 10s);
+        pending_after = sched.pending_number();
+        co_return ret;
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    auto r = shcoro::spawn_async(task(), sched);
+    sched.run();
+
+    auto ret = r.get();
+    ASSERT_TRUE(ret.has_value());
+    EXPECT_EQ(*ret, 42);
+    // the timer registration was withdrawn right away
+    EXPECT_EQ(pending_after, 0u);
+    EXPECT_TRUE(trace.empty());
+    EXPECT_LT(std::chrono::steady_clock::now() - start, 5s);
+}
+
+TEST(TimeoutTest, DeadlineCancelsTask) {
+    shcoro::SteadyTimedScheduler sched;
+    std::vector<std::string> trace;
+    size_t pending_after = 1;
+
+    auto task = [&]() -> shcoro::Async<bool> {
+        auto ret = co_await shcoro::with_timeout(value_after(10s, 42, trace), 5ms);
+        pending_after = sched.pending_number();
+        co_return !ret && ret.value_or(0) == 0;
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    auto r = shcoro::spawn_async(task(), sched);
+    sched.run();
+
+    EXPECT_TRUE(r.get());
+    // the task unwound before with_timeout returned
+    EXPECT_EQ(trace, (std::vector<std::string>{"cancelled"}));
+    EXPECT_EQ(pending_after, 0u);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, 5s);
+}
+
+TEST(TimeoutTest, VoidTask) {
+    shcoro::SteadyTimedScheduler sched;
+    std::vector<bool> results;
+
+    auto sleep = [](std::chrono::milliseconds delay) -> shcoro::Async<void> {
+        co_await shcoro::TimedAwaiter{delay};
+    };
+    auto task = [&]() -> shcoro::Async<void> {
+        results.push_back(bool(co_await shcoro::with_timeout(sleep(1ms), 1s)));
+        results.push_back(bool(co_await shcoro::with_timeout(sleep(1s), 1ms)));
+    };
+
+    auto r = shcoro::spawn_async(task(), sched);
+    sched.run();
+    EXPECT_EQ(results, (std::vector<bool>{true, false}));
+}
+
+TEST(TimeoutTest, OuterCancellationReachesTask) {
+    shcoro::SteadyTimedScheduler sched;
+    shcoro::CancellationSource source;
+    std::vector<std::string> trace;
+
+    auto task = [&]() -> shcoro::Async<int> {
+        auto ret = co_await shcoro::with_timeout(value_after(10s, 42, trace), 10s);
+        co_return ret ? *ret : 0;
+    };
+
+    auto t = task();
+    t.set_cancellation_token(source.token());
+    auto r = shcoro::spawn_async(std::move(t), sched);
+    EXPECT_EQ(sched.pending_number(), 2);
+
+    source.request_cancellation();
+    // the task returned on cancellation, before the deadline
+    EXPECT_EQ(r.get(), -1);
+    EXPECT_EQ(trace, (std::vector<std::string>{"cancelled"}));
+    EXPECT_EQ(sched.pending_number(), 0);
+}
+
+TEST(TimeoutTest, AbandonsTaskIgnoringCancellation) {
+    shcoro::SteadyTimedScheduler sched;
+    std::vector<std::string> trace;
+    size_t pending_after = 1;
+
+    auto stubborn = [&]() -> shcoro::Async<int> {
+        struct Unwound {
+            std::vector<std::string>& trace_;
+            ~Unwound() { trace_.push_back("task destroyed"); }
+        } unwound{trace};
+        while (true) {
+            // ignores that its waits were cancelled
+            (void)co_await shcoro::TimedAwaiter{1ms};
+        }
+    };
+    auto task = [&]() -> shcoro::Async<bool> {
+        auto ret = co_await shcoro::with_timeout(stubborn(), 20ms);
+        trace.push_back("returned");
+        pending_after = sched.pending_number();
+        co_return !ret;
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    auto r = shcoro::spawn_async(task(), sched);
+    sched.run();
+
+    EXPECT_TRUE(r.get());
+    // abandoned in its next wait and destroyed with the awaiter
+    EXPECT_EQ(trace, (std::vector<std::string>{"task destroyed", "returned"}));
+    EXPECT_EQ(pending_after, 0u);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, 5s);
+}
+
+TEST(TimeoutTest, OuterCancellationKeepsDeadline) {
+    shcoro::SteadyTimedScheduler sched;
+    shcoro::CancellationSource source;
+    size_t yields = 0;
+
+    auto stubborn = [&]() -> shcoro::Async<int> {
+        while (true) {
+            (void)co_await shcoro::TimedAwaiter{10s};
+            yields++;
+        }
+    };
+    auto task = [&]() -> shcoro::Async<bool> {
+        auto ret = co_await shcoro::with_timeout(stubborn(), 20ms);
+        co_return !ret;
+    };
+
+    auto t = task();
+    t.set_cancellation_token(source.token());
+    auto r = shcoro::spawn_async(std::move(t), sched);
+    source.request_cancellation();
+
+    auto start = std::chrono::steady_clock::now();
+    sched.run();
+    // the task kept yielding until the deadline expired and abandoned it
+    EXPECT_TRUE(r.get());
+    EXPECT_GT(yields, 0u);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, 5s);
+}
+
+TEST(TimeoutTest, ChannelReceiveTimesOut) {
+    shcoro::SteadyTimedScheduler sched;
+    shcoro::Channel<int, 1> ch;
+    bool timed_out = false;
+
+    auto recv_one = [&]() -> shcoro::Async<int> {
+        auto value = co_await ch.recv();
+        co_return value.value_or(-1);
+    };
+    auto task = [&]() -> shcoro::Async<void> {
+        auto ret = co_await shcoro::with_timeout(recv_one(), 5ms);
+        timed_out = !ret;
+        // the receiver left the channel, the value is buffered
+        co_await ch.send(42);
+    };
+
+    auto r = shcoro::spawn_async(task(), sched);
+    sched.run();
+    EXPECT_TRUE(timed_out);
+    EXPECT_EQ(ch.try_recv(), 42);
+}
+
+TEST(TimeoutTest, CancelsAsyncMutexWait) {
+    shcoro::SteadyTimedScheduler sched;
+    shcoro::AsyncMutex mutex;
+    std::vector<std::string> trace;
+
+    auto lock_once = [&]() -> shcoro::Async<int> {
+        auto guard = co_await mutex.scoped_lock();
+        trace.push_back(guard ? "locked" : "cancelled");
+        co_return 42;
+    };
+    auto holder = [&]() -> shcoro::Async<void> {
+        co_await shcoro::TimedAwaiter{20ms};
+        trace.push_back("unlock");
+        mutex.unlock();
+    };
+    auto task = [&]() -> shcoro::Async<void> {
+        auto ret = co_await shcoro::with_timeout(lock_once(), 1ms);
+        trace.push_back(ret ? "value" : "timeout");
+    };
+
+    ASSERT_TRUE(mutex.try_lock());
+    auto r1 = shcoro::spawn_async(holder(), sched);
+    auto r2 = shcoro::spawn_async(task(), sched);
+    sched.run();
+    EXPECT_EQ(trace, (std::vector<std::string>{"cancelled", "timeout", "unlock"}));
+    EXPECT_TRUE(mutex.try_lock());
+}
+
+#if SHCORO_EXCEPTIONS
+TEST(TimeoutTest, RethrowsTaskException) {
+    shcoro::SteadyTimedScheduler sched;
+
+    auto failing = []() -> shcoro::Async<int> {
+        co_await shcoro::TimedAwaiter{1ms};
+        throw std::runtime_error("with_timeout");
+    };
+    auto task = [&]() -> shcoro::Async<bool> {
+        try {
+            co_await shcoro::with_timeout(failing(), 1s);
+        } catch (const std::runtime_error&) {
+            co_return true;
+        }
+        co_return false;
+    };
+
+    auto r = shcoro::spawn_async(task(), sched);
+    sched.run();
+    EXPECT_TRUE(r.get());
+}
+
+TEST(TimeoutTest, ValueOfTimeoutThrows) {
+    shcoro::expected<int, shcoro::timeout> ret = shcoro::unexpected(shcoro::timeout{});
+    EXPECT_FALSE(ret.has_value());
+    EXPECT_EQ(ret.value_or(7), 7);
+    EXPECT_THROW(ret.value(), shcoro::bad_expected_access);
+}
+#endif
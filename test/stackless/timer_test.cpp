@@ -0,0 +1,125 @@
+#include "shcoro/stackless/timer.hpp"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <ctime>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "shcoro/stackless/fifo_scheduler.hpp"
+#include "shcoro/stackless/timing_wheel.hpp"
+#include "shcoro/stackless/utility.hpp"
+
+using namespace std::chrono_literals;
+
+namespace {
+
+template <typename SchedulerT>
+void check_sub_second_order() {
+    SchedulerT sched;
+    std::vector<int> order;
+
+    auto task = [&](int id, std::chrono::milliseconds delay) -> shcoro::Async<void> {
+        co_await shcoro::TimedAwaiter{delay};
+        order.push_back(id);
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    auto r1 = shcoro::spawn_async(task(1, 30ms), sched);
+    auto r2 = shcoro::spawn_async(task(2, 10ms), sched);
+    auto r3 = shcoro::spawn_async(task(3, 20ms), sched);
+    sched.run();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    EXPECT_EQ(order, (std::vector<int>{2, 3, 1}));
+    EXPECT_GE(elapsed, 30ms);
+    EXPECT_LT(elapsed, 500ms);
+}
+
+}  // namespace
+
+TEST(TimerTest, SteadySubSecond) { check_sub_second_order<shcoro::SteadyTimedScheduler>(); }
+
+TEST(TimerTest, SystemSubSecond) { check_sub_second_order<shcoro::TimedScheduler>(); }
+
+TEST(TimerTest, TimingWheelSubSecond) {
+    check_sub_second_order<shcoro::TimingWheelScheduler>();
+}
+
+TEST(TimerTest, SecondsCompat) {
+    shcoro::SteadyTimedScheduler sched;
+    bool resumed = false;
+
+    auto task = [&]() -> shcoro::Async<void> {
+        co_await shcoro::TimedAwaiter{0};
+        resumed = true;
+    };
+
+    auto r = shcoro::spawn_async(task(), sched);
+    EXPECT_EQ(sched.pending_number(), 1);
+    sched.run();
+    EXPECT_TRUE(resumed);
+}
+
+TEST(TimerTest, ExplicitScheduler) {
+    shcoro::SteadyTimedScheduler timer;
+    bool resumed = false;
+
+    // the awaiting coroutine has no scheduler of its own
+    auto task = [&]() -> shcoro::Async<void> {
+        co_await shcoro::TimedAwaiter{timer, 1ms};
+        resumed = true;
+    };
+
+    auto r = shcoro::spawn_async(task());
+    EXPECT_EQ(timer.pending_number(), 1);
+    timer.run();
+    EXPECT_TRUE(resumed);
+}
+
+// a scheduler without deadlines is rejected at compile time
+static_assert(std::is_constructible_v<shcoro::TimedAwaiter, shcoro::SteadyTimedScheduler&,
+                                      std::chrono::milliseconds>);
+static_assert(!std::is_constructible_v<shcoro::TimedAwaiter, shcoro::FIFOScheduler&,
+                                       std::chrono::milliseconds>);
+static_assert(!std::is_constructible_v<shcoro::TimedAwaiter, shcoro::FIFOScheduler*,
+                                       std::chrono::milliseconds>);
+
+TEST(TimerTest, RunDoesNotSpin) {
+    shcoro::SteadyTimedScheduler sched;
+
+    auto task = []() -> shcoro::Async<void> { co_await shcoro::TimedAwaiter{200ms}; };
+
+    auto r = shcoro::spawn_async(task(), sched);
+    std::clock_t cpu_start = std::clock();
+    sched.run();
+    double cpu_ms = 1000.0 * static_cast<double>(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+    EXPECT_LT(cpu_ms, 50.0);
+}
+
+TEST(TimerTest, EarlierTimerFromOtherThread) {
+    shcoro::SteadyTimedScheduler sched;
+    auto start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::duration resumed_at{};
+
+    auto slow = []() -> shcoro::Async<void> { co_await shcoro::TimedAwaiter{300ms}; };
+    auto fast = [&]() -> shcoro::Async<void> {
+        co_await shcoro::TimedAwaiter{5ms};
+        resumed_at = std::chrono::steady_clock::now() - start;
+    };
+
+    auto r1 = shcoro::spawn_async(slow(), sched);
+    std::optional<shcoro::AsyncRO<void>> r2;
+    std::thread other([&] {
+        std::this_thread::sleep_for(20ms);
+        r2.emplace(shcoro::spawn_async(fast(), sched));
+    });
+    sched.run();
+    other.join();
+
+    EXPECT_GT(resumed_at, 20ms);
+    EXPECT_LT(resumed_at, 200ms);
+}
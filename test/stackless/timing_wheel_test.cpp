@@ -0,0 +1,73 @@
+#include "shcoro/stackless/timing_wheel.hpp"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <vector>
+
+#include "shcoro/stackless/timer.hpp"
+#include "shcoro/stackless/utility.hpp"
+
+TEST(TimingWheelTest, ExpireInOrder) {
+    shcoro::TimingWheelScheduler sched(std::chrono::microseconds(10));
+    std::vector<int> order;
+
+    auto task = [&](int id, time_t seconds) -> shcoro::Async<int> {
+        co_await shcoro::TimedAwaiter{seconds};
+        order.push_back(id);
+        co_return id;
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    auto r1 = shcoro::spawn_async(task(1, 1), sched);
+    auto r2 = shcoro::spawn_async(task(2, 0), sched);
+    auto r3 = shcoro::spawn_async(task(3, 0), sched);
+    EXPECT_EQ(sched.pending_number(), 3);
+    sched.run();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    EXPECT_EQ(order, (std::vector<int>{2, 3, 1}));
+    EXPECT_GE(elapsed, std::chrono::seconds(1));
+    EXPECT_LT(elapsed, std::chrono::seconds(2));
+    EXPECT_EQ(r1.get() + r2.get() + r3.get(), 6);
+}
+
+TEST(TimingWheelTest, UnregisterOnDestroy) {
+    shcoro::TimingWheelScheduler sched;
+    bool resumed = false;
+
+    auto task = [&]() -> shcoro::Async<void> {
+        co_await shcoro::TimedAwaiter{100};
+        resumed = true;
+    };
+
+    {
+        auto r = shcoro::spawn_async(task(), sched);
+        EXPECT_EQ(sched.pending_number(), 1);
+    }
+    EXPECT_EQ(sched.pending_number(), 0);
+    sched.run();
+    EXPECT_FALSE(resumed);
+}
+
+TEST(TimingWheelTest, ForeignHandle) {
+    shcoro::TimingWheelScheduler sched;
+    int resumed = 0;
+
+    // plain handle registration goes through the allocating fallback
+    auto task = [&]() -> shcoro::Async<void> {
+        auto self = co_await shcoro::GetCoroAwaiter{};
+        sched.register_coro(self, 0);
+        co_await std::suspend_always{};
+        resumed++;
+    };
+
+    auto r1 = shcoro::spawn_async(task(), sched);
+    {
+        auto r2 = shcoro::spawn_async(task(), sched);
+        EXPECT_EQ(sched.pending_number(), 2);
+    }
+    EXPECT_EQ(sched.pending_number(), 1);
+    sched.run();
+    EXPECT_EQ(resumed, 1);
+}
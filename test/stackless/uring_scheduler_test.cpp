@@ -0,0 +1,279 @@
+#include "shcoro/stackless/uring_scheduler.hpp"
+
+#include <arpa/inet.h>
+#include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "shcoro/stackless/utility.hpp"
+
+using namespace std::chrono_literals;
+
+namespace {
+
+// io_uring may be disabled by the kernel or a seccomp profile
+std::unique_ptr<shcoro::UringScheduler> make_scheduler(uint32_t entries = 256) {
+#if SHCORO_EXCEPTIONS
+    try {
+        return std::make_unique<shcoro::UringScheduler>(entries);
+    } catch (const std::system_error&) {
+        return nullptr;
+    }
+#else
+    // the constructor aborts on failure, probe with a throwaway ring first
+    io_uring_params params{};
+    int fd = static_cast<int>(::syscall(__NR_io_uring_setup, 1, &params));
+    if (fd < 0) {
+        return nullptr;
+    }
+    ::close(fd);
+    return std::make_unique<shcoro::UringScheduler>(entries);
+#endif
+}
+
+}  // namespace
+
+TEST(UringSchedulerTest, PipeReadWrite) {
+    auto sched = make_scheduler();
+    if (!sched) GTEST_SKIP() << "io_uring is not available";
+
+    int fds[2];
+    ASSERT_EQ(::pipe(fds), 0);
+    std::string received;
+
+    auto reader = [&]() -> shcoro::Async<void> {
+        char buf[16];
+        int n = co_await shcoro::uring_read(fds[0], buf, sizeof(buf));
+        received.assign(buf, n > 0 ? n : 0);
+    };
+    auto writer = [&]() -> shcoro::Async<int> {
+        co_return co_await shcoro::uring_write(fds[1], "hello", 5);
+    };
+
+    auto r1 = shcoro::spawn_async(reader(), *sched);
+    auto r2 = shcoro::spawn_async(writer(), *sched);
+    EXPECT_EQ(sched->pending_number(), 2);
+    sched->run();
+
+    EXPECT_EQ(r2.get(), 5);
+    EXPECT_EQ(received, "hello");
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+TEST(UringSchedulerTest, FileReadAtOffset) {
+    auto sched = make_scheduler();
+    if (!sched) GTEST_SKIP() << "io_uring is not available";
+
+    FILE* file = std::tmpfile();
+    ASSERT_NE(file, nullptr);
+    std::fputs("0123456789", file);
+    std::fflush(file);
+
+    auto reader = [&]() -> shcoro::Async<std::string> {
+        char buf[4];
+        int n = co_await shcoro::uring_read(::fileno(file), buf, sizeof(buf), 3);
+        co_return std::string(buf, n > 0 ? n : 0);
+    };
+
+    auto r = shcoro::spawn_async(reader(), *sched);
+    sched->run();
+    EXPECT_EQ(r.get(), "3456");
+    std::fclose(file);
+}
+
+TEST(UringSchedulerTest, TimeoutsCompleteInOrder) {
+    auto sched = make_scheduler();
+    if (!sched) GTEST_SKIP() << "io_uring is not available";
+
+    std::vector<int> order;
+    auto task = [&](int id, std::chrono::milliseconds delay) -> shcoro::Async<void> {
+        int res = co_await shcoro::uring_timeout(delay);
+        EXPECT_EQ(res, 0);
+        order.push_back(id);
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    auto r1 = shcoro::spawn_async(task(1, 30ms), *sched);
+    auto r2 = shcoro::spawn_async(task(2, 10ms), *sched);
+    sched->run();
+
+    EXPECT_GE(std::chrono::steady_clock::now() - start, 30ms);
+    EXPECT_EQ(order, (std::vector<int>{2, 1}));
+}
+
+TEST(UringSchedulerTest, MoreRequestsThanRingEntries) {
+    auto sched = make_scheduler(4);
+    if (!sched) GTEST_SKIP() << "io_uring is not available";
+
+    // the submission ring fills up while the completions overflow their ring
+    int done = 0;
+    auto task = [&]() -> shcoro::Async<void> {
+        int res = co_await shcoro::uring_timeout(0ms);
+        EXPECT_EQ(res, 0);
+        done++;
+    };
+
+    std::vector<shcoro::AsyncRO<void>> results;
+    for (int i = 0; i < 100; i++) {
+        results.push_back(shcoro::spawn_async(task(), *sched));
+    }
+    sched->run();
+    EXPECT_EQ(done, 100);
+}
+
+TEST(UringSchedulerTest, CompletionsSubmitIntoFullRing) {
+    auto sched = make_scheduler(4);
+    if (!sched) GTEST_SKIP() << "io_uring is not available";
+
+    // resumed waiters refill the submission ring while reap() is still walking
+    // the completion ring, so get_sqe() stashes the completions left behind
+    int done = 0;
+    auto task = [&]() -> shcoro::Async<void> {
+        for (int i = 0; i < 3; i++) {
+            int res = co_await shcoro::uring_timeout(1ms);
+            EXPECT_EQ(res, 0);
+            done++;
+        }
+    };
+
+    std::vector<shcoro::AsyncRO<void>> results;
+    for (int i = 0; i < 8; i++) {
+        results.push_back(shcoro::spawn_async(task(), *sched));
+    }
+    sched->run();
+    EXPECT_EQ(done, 24);
+}
+
+TEST(UringSchedulerTest, AcceptLoopback) {
+    auto sched = make_scheduler();
+    if (!sched) GTEST_SKIP() << "io_uring is not available";
+
+    int listener = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ASSERT_EQ(::bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+    ASSERT_EQ(::listen(listener, 4), 0);
+    socklen_t len = sizeof(addr);
+    ::getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &len);
+
+    std::string received;
+    auto server = [&]() -> shcoro::Async<void> {
+        int conn = co_await shcoro::uring_accept(listener);
+        char buf[16];
+        int n = co_await shcoro::uring_read(conn, buf, sizeof(buf));
+        received.assign(buf, n > 0 ? n : 0);
+        ::close(conn);
+    };
+
+    auto r = shcoro::spawn_async(server(), *sched);
+    sched->run_once();
+
+    int client = ::socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_EQ(::connect(client, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+    ::write(client, "ping", 4);
+    sched->run();
+
+    EXPECT_EQ(received, "ping");
+    ::close(client);
+    ::close(listener);
+}
+
+TEST(UringSchedulerTest, DestroyedWaiterIsCancelled) {
+    auto sched = make_scheduler();
+    if (!sched) GTEST_SKIP() << "io_uring is not available";
+
+    int fds[2];
+    ASSERT_EQ(::pipe(fds), 0);
+    char buf[16];
+
+    auto reader = [&]() -> shcoro::Async<void> {
+        co_await shcoro::uring_read(fds[0], buf, sizeof(buf));
+    };
+
+    {
+        auto r = shcoro::spawn_async(reader(), *sched);
+        sched->run_once();
+        EXPECT_EQ(sched->pending_number(), 1);
+    }
+    EXPECT_EQ(sched->pending_number(), 0);
+
+    // the cancelled read completes without resuming anything
+    int done = 0;
+    auto timer = [&]() -> shcoro::Async<void> {
+        co_await shcoro::uring_timeout(5ms);
+        done++;
+    };
+    auto r = shcoro::spawn_async(timer(), *sched);
+    sched->run();
+    EXPECT_EQ(done, 1);
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+TEST(UringSchedulerTest, CancelledReadWaitsForItsCompletion) {
+    auto sched = make_scheduler();
+    if (!sched) GTEST_SKIP() << "io_uring is not available";
+
+    int fds[2];
+    ASSERT_EQ(::pipe(fds), 0);
+    shcoro::CancellationSource source;
+    char buf[16];
+    int result = 0;
+
+    auto reader = [&]() -> shcoro::Async<void> {
+        result = co_await shcoro::uring_read(fds[0], buf, sizeof(buf));
+    };
+
+    auto t = reader();
+    t.set_cancellation_token(source.token());
+    auto r = shcoro::spawn_async(std::move(t), *sched);
+    sched->run_once();
+
+    source.request_cancellation();
+    // the kernel may still use buf, the reader waits for the completion
+    EXPECT_EQ(result, 0);
+    EXPECT_EQ(sched->pending_number(), 1);
+    sched->run();
+    EXPECT_EQ(result, -ECANCELED);
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+TEST(UringSchedulerTest, CancelledReadKeepsCompletedResult) {
+    auto sched = make_scheduler();
+    if (!sched) GTEST_SKIP() << "io_uring is not available";
+
+    int fds[2];
+    ASSERT_EQ(::pipe(fds), 0);
+    shcoro::CancellationSource source;
+    char buf[16];
+    int result = 0;
+
+    auto reader = [&]() -> shcoro::Async<void> {
+        result = co_await shcoro::uring_read(fds[0], buf, sizeof(buf));
+    };
+
+    auto t = reader();
+    t.set_cancellation_token(source.token());
+    auto r = shcoro::spawn_async(std::move(t), *sched);
+    sched->run_once();
+
+    // the read completes before the cancellation reaches the kernel
+    ASSERT_EQ(::write(fds[1], "hello", 5), 5);
+    source.request_cancellation();
+    sched->run();
+    EXPECT_EQ(result, 5);
+    EXPECT_EQ(std::string(buf, 5), "hello");
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
@@ -0,0 +1,303 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "shcoro/stackless/fifo_scheduler.hpp"
+#include "shcoro/stackless/timer.hpp"
+#include "shcoro/stackless/utility.hpp"
+#include "shcoro/stackless/work_stealing_scheduler.hpp"
+
+using namespace std::chrono_literals;
+
+namespace {
+
+shcoro::Async<int> value_after_yields(int value, int yields) {
+    for (int i = 0; i < yields; i++) {
+        co_await shcoro::FIFOAwaiter{};
+    }
+    co_return value;
+}
+
+}  // namespace
+
+TEST(WhenTest, WhenAllKeepsTaskOrder) {
+    shcoro::IntrusiveFIFOScheduler sched;
+
+    auto task = [&]() -> shcoro::Async<std::vector<int>> {
+        std::vector<shcoro::Async<int>> tasks;
+        for (int i = 0; i < 100; i++) {
+            tasks.push_back(value_after_yields(i, (i * 7) % 5));
+        }
+        co_return co_await shcoro::when_all(std::move(tasks));
+    };
+
+    auto r = shcoro::spawn_async(task(), sched);
+    sched.run();
+
+    auto results = r.get();
+    ASSERT_EQ(results.size(), 100u);
+    for (int i = 0; i < 100; i++) {
+        EXPECT_EQ(results[i], i);
+    }
+}
+
+TEST(WhenTest, WhenAllOfReadyTasksDoesNotSuspend) {
+    auto task = [&]() -> shcoro::Async<int> {
+        std::vector<shcoro::Async<int>> tasks;
+        tasks.push_back(value_after_yields(1, 0));
+        tasks.push_back(value_after_yields(2, 0));
+        auto results = co_await shcoro::when_all(std::move(tasks));
+        co_return results[0] + results[1];
+    };
+
+    // no scheduler, the result is there once spawn_async returns
+    auto r = shcoro::spawn_async(task());
+    EXPECT_EQ(r.get(), 3);
+}
+
+TEST(WhenTest, WhenAllOfNothing) {
+    auto task = [&]() -> shcoro::Async<size_t> {
+        auto results = co_await shcoro::when_all(std::vector<shcoro::Async<int>>{});
+        co_return results.size();
+    };
+
+    auto r = shcoro::spawn_async(task());
+    EXPECT_EQ(r.get(), 0u);
+}
+
+TEST(WhenTest, WhenAllOfVoidTasksFromList) {
+    shcoro::IntrusiveFIFOScheduler sched;
+    int finished = 0;
+
+    auto work = [&](int yields) -> shcoro::Async<void> {
+        co_await value_after_yields(0, yields);
+        finished++;
+    };
+    auto task = [&]() -> shcoro::Async<void> {
+        std::list<shcoro::Async<void>> tasks;
+        for (int i = 0; i < 10; i++) {
+            tasks.push_back(work(i % 3));
+        }
+        co_await shcoro::when_all(tasks);
+        EXPECT_EQ(finished, 10);
+    };
+
+    auto r = shcoro::spawn_async(task(), sched);
+    sched.run();
+    EXPECT_EQ(finished, 10);
+}
+
+TEST(WhenTest, WhenAllAcrossThreads) {
+    shcoro::WorkStealingScheduler pool(4);
+
+    auto task = [&]() -> shcoro::Async<long> {
+        long sum = 0;
+        for (int round = 0; round < 20; round++) {
+            std::vector<shcoro::Async<int>> tasks;
+            for (int i = 0; i < 200; i++) {
+                tasks.push_back(value_after_yields(i, i % 4));
+            }
+            for (int value : co_await shcoro::when_all(std::move(tasks))) {
+                sum += value;
+            }
+        }
+        co_return sum;
+    };
+
+    auto r = shcoro::spawn_async(task(), pool);
+    pool.run();
+    EXPECT_EQ(r.get(), 20L * 199 * 200 / 2);
+}
+
+TEST(WhenTest, WhenAnyReturnsFirstToFinish) {
+    shcoro::IntrusiveFIFOScheduler sched;
+
+    auto task = [&]() -> shcoro::Async<int> {
+        std::vector<shcoro::Async<int>> tasks;
+        tasks.push_back(value_after_yields(10, 3));
+        tasks.push_back(value_after_yields(20, 1));
+        tasks.push_back(value_after_yields(30, 2));
+        auto [index, value] = co_await shcoro::when_any(std::move(tasks));
+        EXPECT_EQ(index, 1u);
+        co_return value;
+    };
+
+    auto r = shcoro::spawn_async(task(), sched);
+    sched.run();
+    EXPECT_EQ(r.get(), 20);
+}
+
+TEST(WhenTest, WhenAnyReadyTaskSkipsTheRest) {
+    std::vector<std::string> trace;
+
+    auto traced = [&](std::string name) -> shcoro::Async<void> {
+        trace.push_back(name);
+        co_return;
+    };
+    auto task = [&]() -> shcoro::Async<size_t> {
+        std::vector<shcoro::Async<void>> tasks;
+        tasks.push_back(traced("a"));
+        tasks.push_back(traced("b"));
+        auto ret = co_await shcoro::when_any(std::move(tasks));
+        co_return ret.first;
+    };
+
+    auto r = shcoro::spawn_async(task());
+    EXPECT_EQ(r.get(), 0u);
+    EXPECT_EQ(trace, (std::vector<std::string>{"a"}));
+}
+
+TEST(WhenTest, WhenAnyCancelsLosers) {
+    shcoro::SteadyTimedScheduler sched;
+    std::vector<std::string> trace;
+    size_t pending_after = 1;
+
+    auto wait = [&](std::chrono::milliseconds delay, int id) -> shcoro::Async<int> {
+        bool expired = co_await shcoro::TimedAwaiter{delay};
+        if (!expired) {
+            trace.push_back("cancelled " + std::to_string(id));
+        }
+        co_return id;
+    };
+    auto task = [&]() -> shcoro::Async<int> {
+        std::vector<shcoro::Async<int>> tasks;
+        tasks.push_back(wait(10s, 0));
+        tasks.push_back(wait(10ms, 1));
+        tasks.push_back(wait(10s, 2));
+        auto ret = co_await shcoro::when_any(std::move(tasks));
+        pending_after = sched.pending_number();
+        co_return ret.second;
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    auto r = shcoro::spawn_async(task(), sched);
+    sched.run();
+
+    EXPECT_EQ(r.get(), 1);
+    std::sort(trace.begin(), trace.end());
+    EXPECT_EQ(trace, (std::vector<std::string>{"cancelled 0", "cancelled 2"}));
+    // the 10s timers were withdrawn before when_any returned
+    EXPECT_EQ(pending_after, 0u);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, 5s);
+}
+
+TEST(WhenTest, WhenAnyAcrossThreads) {
+    shcoro::WorkStealingScheduler pool(4);
+    std::atomic<int> cancelled{0};
+
+    auto work = [&](int value, int yields) -> shcoro::Async<int> {
+        for (int i = 0; i < yields; i++) {
+            bool resumed = co_await shcoro::FIFOAwaiter{};
+            if (!resumed) {
+                cancelled.fetch_add(1, std::memory_order_relaxed);
+                co_return -1;
+            }
+        }
+        co_return value;
+    };
+    auto task = [&]() -> shcoro::Async<int> {
+        int wins = 0;
+        for (int round = 0; round < 50; round++) {
+            std::vector<shcoro::Async<int>> tasks;
+            for (int i = 0; i < 16; i++) {
+                tasks.push_back(work(i, 1 + (i * 7 + round) % 16));
+            }
+            auto [index, value] = co_await shcoro::when_any(std::move(tasks));
+            // the losers were cancelled on their workers and unwound by now
+            if (value == static_cast<int>(index)) {
+                wins++;
+            }
+        }
+        co_return wins;
+    };
+
+    auto r = shcoro::spawn_async(task(), pool);
+    pool.run();
+    EXPECT_EQ(r.get(), 50);
+    EXPECT_GT(cancelled.load(), 0);
+}
+
+TEST(WhenTest, WhenAnyAbandonsLoopingLosersAcrossThreads) {
+    shcoro::WorkStealingScheduler pool(4);
+    std::atomic<int> destroyed{0};
+
+    struct Unwound {
+        std::atomic<int>& destroyed_;
+        ~Unwound() { destroyed_.fetch_add(1, std::memory_order_relaxed); }
+    };
+    // never finishes and ignores the cancellation of its yields
+    auto looping = [&]() -> shcoro::Async<int> {
+        Unwound unwound{destroyed};
+        for (;;) {
+            (void)co_await shcoro::FIFOAwaiter{};
+        }
+    };
+    auto winner = [](int yields) -> shcoro::Async<int> {
+        for (int i = 0; i < yields; i++) {
+            co_await shcoro::FIFOAwaiter{};
+        }
+        co_return -1;
+    };
+    auto task = [&]() -> shcoro::Async<int> {
+        int wins = 0;
+        for (int round = 0; round < 50; round++) {
+            std::vector<shcoro::Async<int>> tasks;
+            for (int i = 0; i < 15; i++) {
+                tasks.push_back(looping());
+            }
+            tasks.push_back(winner(round % 4));
+            auto [index, value] = co_await shcoro::when_any(std::move(tasks));
+            if (index == 15 && value == -1) {
+                wins++;
+            }
+        }
+        co_return wins;
+    };
+
+    auto r = shcoro::spawn_async(task(), pool);
+    pool.run();
+    EXPECT_EQ(r.get(), 50);
+    EXPECT_EQ(destroyed.load(), 50 * 15);
+    EXPECT_EQ(pool.pending_number(), 0);
+}
+
+#if SHCORO_EXCEPTIONS
+TEST(WhenTest, WhenAllRethrowsTaskException) {
+    shcoro::IntrusiveFIFOScheduler sched;
+
+    auto work = [](int value) -> shcoro::Async<int> {
+        co_await shcoro::FIFOAwaiter{};
+        if (value == 2) {
+            throw std::runtime_error("when_all");
+        }
+        co_return value;
+    };
+    auto task = [&]() -> shcoro::Async<bool> {
+        std::vector<shcoro::Async<int>> tasks;
+        for (int i = 0; i < 4; i++) {
+            tasks.push_back(work(i));
+        }
+        try {
+            co_await shcoro::when_all(std::move(tasks));
+        } catch (const std::runtime_error&) {
+            co_return true;
+        }
+        co_return false;
+    };
+
+    auto r = shcoro::spawn_async(task(), sched);
+    sched.run();
+    EXPECT_TRUE(r.get());
+}
+
+TEST(WhenTest, WhenAnyOfNothingThrows) {
+    EXPECT_THROW((void)shcoro::when_any(std::vector<shcoro::Async<int>>{}),
+                 std::invalid_argument);
+}
+#endif
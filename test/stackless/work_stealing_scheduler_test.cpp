@@ -0,0 +1,151 @@
+#include "shcoro/stackless/work_stealing_scheduler.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "shcoro/stackless/fifo_scheduler.hpp"
+#include "shcoro/stackless/utility.hpp"
+
+TEST(WorkStealingSchedulerTest, RunsAllTasks) {
+    shcoro::WorkStealingScheduler pool(4);
+    std::atomic<int> resumed{0};
+
+    auto task = [&](int x) -> shcoro::Async<int> {
+        for (int i = 0; i < 100; i++) {
+            co_await shcoro::FIFOAwaiter{};
+            resumed.fetch_add(1, std::memory_order_relaxed);
+        }
+        co_return x * 2;
+    };
+
+    std::vector<shcoro::AsyncRO<int>> results;
+    for (int i = 0; i < 64; i++) {
+        results.push_back(shcoro::spawn_async(task(i), pool));
+    }
+    pool.run();
+
+    EXPECT_EQ(resumed.load(), 64 * 100);
+    EXPECT_EQ(pool.pending_number(), 0);
+    for (int i = 0; i < 64; i++) {
+        EXPECT_EQ(results[i].get(), i * 2);
+    }
+}
+
+TEST(WorkStealingSchedulerTest, NestedAsync) {
+    shcoro::WorkStealingScheduler pool(3);
+
+    auto inner = [](int x) -> shcoro::Async<int> {
+        co_await shcoro::FIFOAwaiter{};
+        co_return x + 1;
+    };
+    auto outer = [&](int x) -> shcoro::Async<int> {
+        int sum = 0;
+        for (int i = 0; i < 10; i++) {
+            sum += co_await inner(x);
+        }
+        co_return sum;
+    };
+
+    std::vector<shcoro::AsyncRO<int>> results;
+    for (int i = 0; i < 32; i++) {
+        results.push_back(shcoro::spawn_async(outer(i), pool));
+    }
+    pool.run();
+
+    for (int i = 0; i < 32; i++) {
+        EXPECT_EQ(results[i].get(), (i + 1) * 10);
+    }
+}
+
+TEST(WorkStealingSchedulerTest, UsesMultipleWorkers) {
+    shcoro::WorkStealingScheduler pool(4);
+    std::mutex mutex;
+    std::set<std::thread::id> threads;
+
+    auto task = [&]() -> shcoro::Async<void> {
+        for (int i = 0; i < 50; i++) {
+            co_await shcoro::FIFOAwaiter{};
+            {
+                std::lock_guard<std::mutex> guard(mutex);
+                threads.insert(std::this_thread::get_id());
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(10));
+        }
+    };
+
+    std::vector<shcoro::AsyncRO<void>> results;
+    for (int i = 0; i < 16; i++) {
+        results.push_back(shcoro::spawn_async(task(), pool));
+    }
+    pool.run();
+
+    EXPECT_GT(threads.size(), 1u);
+}
+
+TEST(WorkStealingSchedulerTest, AnyOfWithdrawsQueuedLoser) {
+    shcoro::WorkStealingScheduler pool(1);
+    int loser_resumed = 0;
+
+    auto loser = [&]() -> shcoro::Async<int> {
+        for (;;) {
+            bool resumed = co_await shcoro::FIFOAwaiter{};
+            if (!resumed) {
+                co_return -1;
+            }
+            loser_resumed++;
+        }
+    };
+    auto winner = []() -> shcoro::Async<int> { co_return 2; };
+    auto task = [&]() -> shcoro::Async<int> {
+        // the loser is queued when the winner finishes, its yield gets withdrawn
+        auto ret = co_await shcoro::any_of(loser(), winner());
+        co_return std::get<1>(ret).value;
+    };
+
+    auto r = shcoro::spawn_async(task(), pool);
+    pool.run();
+
+    EXPECT_EQ(r.get(), 2);
+    EXPECT_EQ(loser_resumed, 0);
+    EXPECT_EQ(pool.pending_number(), 0);
+}
+
+TEST(WorkStealingSchedulerTest, YieldingTaskDoesNotStarveInjected) {
+    shcoro::WorkStealingScheduler pool(1);
+    int loser_resumed = 0;
+
+    auto loser = [&]() -> shcoro::Async<int> {
+        for (int i = 0; i < 100000; i++) {
+            bool resumed = co_await shcoro::FIFOAwaiter{};
+            if (!resumed) {
+                co_return -1;
+            }
+            loser_resumed++;
+        }
+        co_return -2;
+    };
+    auto winner = []() -> shcoro::Async<int> {
+        co_await shcoro::FIFOAwaiter{};
+        co_return 2;
+    };
+    auto task = [&]() -> shcoro::Async<int> {
+        std::vector<shcoro::Async<int>> tasks;
+        tasks.push_back(loser());
+        tasks.push_back(winner());
+        auto [index, value] = co_await shcoro::when_any(std::move(tasks));
+        co_return value;
+    };
+
+    // started outside the pool: both first yields go through the injection queue, then
+    // the loser keeps re-yielding on the worker's own deque
+    auto r = shcoro::spawn_async(task(), pool);
+    pool.run();
+
+    EXPECT_EQ(r.get(), 2);
+    EXPECT_LT(loser_resumed, 1000);
+}